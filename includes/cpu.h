@@ -3,6 +3,12 @@
 
 #include <stdio.h>
 
+/**
+Timing
+*/
+#define CPU_CLOCK_SPEED      4194304
+#define CPU_CYCLES_PER_FRAME 70224
+
 /**
 Bit manipulation
 */
@@ -150,7 +156,11 @@ struct cpu_state {
 	unsigned char halt;
 	short dma_transfer;
 	unsigned long long total_cycles;
+	unsigned long long total_frames; /* V_BLANK entries */
+	unsigned long long total_instructions;
 	short lcd_wait_cycles;
+	unsigned long long lcd_synced_cycles; /* total_cycles the LCD caught up to */
+	unsigned long long lcd_next_sync;     /* total_cycles of its next state change */
 	struct registers registers;
 };
 
@@ -161,13 +171,13 @@ void cpu_rom_reset();
 struct cpu_state cpu_getState();
 void cpu_setState(struct cpu_state state);
 
-unsigned char cpu_step();
+unsigned long cpu_step();
+unsigned long cpu_run(unsigned long cycles);
 
 extern struct cpu_state cpu_state;
 
 #ifdef DISASSEMBLE
-extern char disassembly[256];
-extern short disassembly_pc;
+extern unsigned short disassembly_pc;
 #endif
 
 #endif
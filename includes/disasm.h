@@ -0,0 +1,28 @@
+#ifndef __DISASM_H
+#define __DISASM_H
+
+/**
+Longest text disasm() produces, including the terminator
+*/
+#define DISASM_MAX_LENGTH 32
+
+enum disasm_operand {
+	DISASM_NONE,
+	DISASM_U8,    // n
+	DISASM_U16,   // nn
+	DISASM_S8,    // Signed offset
+	DISASM_REL8,  // JR target, printed as an address
+	DISASM_OPCODE // Not an instruction, print the byte itself
+};
+
+struct disasm_entry {
+	const char * format;
+	unsigned char length;
+	unsigned char operand;
+};
+
+int disasm_bytes(unsigned short addr, const unsigned char * bytes, char * buf);
+void disasm_mnemonic(const unsigned char * bytes, char * buf);
+int disasm(unsigned short addr, char * buf);
+
+#endif
@@ -6,6 +6,9 @@
 #define VERSION_MAJOR   0
 #define VERSION_MINOR   1
 
+// One frame of the real hardware, about 59.7 Hz
+#define EMULATOR_FRAME_NS (1000000000ull * CPU_CYCLES_PER_FRAME / CPU_CLOCK_SPEED)
+
 void emulator_init();
 
 #endif
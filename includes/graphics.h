@@ -8,16 +8,35 @@
 
 #define GRAPHICS_SCALE 4
 
+/**
+Shades after the palette, as ARGB8888
+*/
+#define GRAPHICS_WHITE      0xFFFFFFFF
+#define GRAPHICS_LIGHT_GRAY 0xFFAAAAAA
+#define GRAPHICS_DARK_GRAY  0xFF555555
+#define GRAPHICS_BLACK      0xFF000000
+
+/**
+Frame being drawn by the emulation thread, LCD_SCREEN_WIDTH
+pixels per line. Changes with every graphics_render().
+*/
+extern unsigned int * graphics_framebuffer;
+
+/**
+Signature of every line in graphics_framebuffer, set by whoever draws
+the line. GRAPHICS_UNKNOWN_LINE never matches, lines with the same
+signature are the same and are not uploaded again.
+*/
+#define GRAPHICS_UNKNOWN_LINE 0
+extern unsigned long long * graphics_signatures;
+
+void graphics_setHeadless(char enabled);
 void graphics_init();
 void graphics_destroy();
+void graphics_pollEvents();
 
 void graphics_screen_off();
 
-void graphics_setColor(int r, int g, int b, int a);
-void graphics_drawPixel(int x, int y);
-void graphics_clearScreen();
 void graphics_render();
 
-void graphics_update();
-
 #endif
@@ -0,0 +1,56 @@
+#ifndef __INPUT_H
+#define __INPUT_H
+
+/**
+Events between the window (frontend) and the core (power of 2)
+*/
+#define INPUT_QUEUE_SIZE 64
+#define INPUT_BITS       10 // Bits used by enum input_button
+
+/**
+Bits in input_buttons, low nibble is the direction keys and
+high nibble the buttons, in the order P1 reports them
+*/
+enum input_button {
+	INPUT_RIGHT  = 0x01,
+	INPUT_LEFT   = 0x02,
+	INPUT_UP     = 0x04,
+	INPUT_DOWN   = 0x08,
+	INPUT_A      = 0x10,
+	INPUT_B      = 0x20,
+	INPUT_SELECT = 0x40,
+	INPUT_START  = 0x80,
+	INPUT_QUIT   = 0x100, // Window closed, never in input_buttons
+	INPUT_TURBO  = 0x200  // Turbo hotkey, never in input_buttons
+};
+
+struct input_event {
+	unsigned short button;
+	unsigned char pressed;
+	unsigned long long time; // input_now() clock, when the window system got it
+};
+
+/**
+Ring from the frontend to the core. Window events can only be polled
+on the main thread, which also runs the core, so nothing is shared
+between threads and the ring needs no atomics.
+*/
+struct input_queue {
+	struct input_event events[INPUT_QUEUE_SIZE];
+	unsigned int head;    // Next event to fill, by the frontend
+	unsigned int tail;    // Next event to take, by the core
+};
+
+/**
+Buttons held down as of the last input_poll(), and when each
+of them (by bit) was last pressed
+*/
+extern unsigned char input_buttons;
+extern unsigned long long input_pressed_at[8];
+
+unsigned long long input_now();
+char input_push(unsigned short button, char pressed, unsigned long long time);
+char input_flush();
+unsigned char input_poll();
+
+#endif
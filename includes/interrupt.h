@@ -10,6 +10,7 @@ enum interrupts {
 };
 
 void interrupt_init();
+char interrupt_pending();
 void interrupt_handle();
 void interrupt_trigger(enum interrupts interrupt);
 
@@ -0,0 +1,34 @@
+#ifndef __JOYPAD_H
+#define __JOYPAD_H
+
+#include <stdio.h>
+
+/**
+P1 ($FF00)
+	Bit 5 - P15 Select Button Keys      (0=Select)
+	Bit 4 - P14 Select Direction Keys   (0=Select)
+	Bit 3 - P13 Down  or Start          (0=Pressed)
+	Bit 2 - P12 Up    or Select         (0=Pressed)
+	Bit 1 - P11 Left  or B              (0=Pressed)
+	Bit 0 - P10 Right or A              (0=Pressed)
+*/
+#define JOYPAD_SELECT_DIRECTIONS 0x10
+#define JOYPAD_SELECT_BUTTONS    0x20
+
+/**
+Input latency histogram, bucket n counts latencies below 2^n us
+*/
+#define JOYPAD_LATENCY_BUCKETS 24
+
+/**
+Least time between two polls of the window events from P1 reads, us
+*/
+#define JOYPAD_EVENTS_INTERVAL 500
+
+extern unsigned long long joypad_latency[JOYPAD_LATENCY_BUCKETS];
+
+void joypad_update();
+unsigned char joypad_read();
+void joypad_report(FILE * fp);
+
+#endif
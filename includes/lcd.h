@@ -3,6 +3,8 @@
 
 #define LCD_TILE_SIZE 16
 
+#define LCD_TURBO_INTERVAL 10 // Frames per drawn frame in turbo by default
+
 /**
 LCD Colors:
 	00: White
@@ -12,7 +14,23 @@ LCD Colors:
 */
 
 void lcd_init();
+void lcd_reset();
 void lcd_dma_transfer(unsigned char val);
-void lcd_update(unsigned char cycles);
+void lcd_update(unsigned int cycles);
+void lcd_sync();
+void lcd_writeControl(unsigned char val);
+void lcd_oamChanged();
+void lcd_vramChanged(unsigned short address, unsigned int len);
+void lcd_setSkipUnchanged(char enabled);
+
+extern char lcd_deferred;
+void lcd_setDeferred(char enabled);
+void lcd_logWrite(unsigned short address, unsigned char val);
+
+extern char lcd_turbo;
+void lcd_setTurbo(char enabled);
+void lcd_setTurboInterval(unsigned int frames);
+
+unsigned int lcd_idleCycles();
 
 #endif
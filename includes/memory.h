@@ -65,4 +65,8 @@ void memory_write16(unsigned short address, short val);
 
 void memory_lockRegion(enum memory_lock_regions region, enum memory_op op);
 
+char memory_isPlain(unsigned short address, unsigned int len, enum memory_op op);
+void memory_fill(unsigned short address, unsigned char val, unsigned int len);
+void memory_copy(unsigned short dst, unsigned short src, unsigned int len);
+
 #endif
@@ -0,0 +1,29 @@
+#ifndef __PERF_H
+#define __PERF_H
+
+#include <stdio.h>
+
+/**
+Host hardware counters, Linux only (perf_event_open)
+*/
+enum perf_counter {
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_BRANCH_MISSES,
+	PERF_L1I_MISSES,
+	PERF_L1D_MISSES,
+	PERF_COUNTERS
+};
+
+/**
+Set while counters are open
+*/
+extern char perf_enabled;
+
+int  perf_open();
+void perf_start();
+void perf_stop();
+void perf_frame();
+void perf_report(FILE * fp);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef __PROFILER_H
+#define __PROFILER_H
+
+#include <stdio.h>
+
+#define PROFILER_MAX_BANKS   512
+#define PROFILER_MAX_SYMBOLS 8192
+#define PROFILER_REPORT_SIZE 32
+#define PROFILER_MAX_NODES   65536
+#define PROFILER_STACK_DEPTH 256
+#define PROFILER_PHASE_DEPTH 8
+
+/**
+total_cycles at which the next sample is taken
+Never reached while the profiler is disabled
+*/
+extern unsigned long long profiler_next_sample;
+/**
+Set while the call graph is being recorded
+*/
+extern char profiler_callgraph;
+
+#ifdef PROFILE_OPCODES
+struct profiler_opcode {
+	unsigned long long count;
+	unsigned long long cycles;
+};
+
+/**
+$00-$FF primary opcodes, $100-$1FF CB prefixed opcodes
+The $CB entry covers all prefixed instructions
+*/
+extern struct profiler_opcode profiler_opcodes[0x200];
+#endif
+
+#ifdef PROFILE_PHASES
+/**
+Host time is charged to the innermost running phase
+*/
+enum profiler_phase {
+	PHASE_CPU,
+	PHASE_LCD,
+	PHASE_SCANLINE,
+	PHASE_RENDER,
+	PHASE_EVENTS,
+	PHASE_INTERRUPTS,
+	PHASE_COUNT
+};
+
+void profiler_phaseBegin(enum profiler_phase phase);
+void profiler_phaseEnd();
+void profiler_phaseFrame();
+
+#define PHASE_BEGIN(phase) profiler_phaseBegin(phase)
+#define PHASE_END()        profiler_phaseEnd()
+#else
+#define PHASE_BEGIN(phase)
+#define PHASE_END()
+#endif
+
+void profiler_init(unsigned int interval);
+void profiler_loadSymbols(char * filename);
+void profiler_sample(unsigned short pc);
+void profiler_report(FILE * fp);
+
+void profiler_initCallgraph(char * filename);
+void profiler_call(unsigned short address, unsigned short sp);
+void profiler_return(unsigned short sp);
+void profiler_interrupt(unsigned short vector, unsigned short sp);
+
+#endif
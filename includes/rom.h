@@ -25,5 +25,6 @@ struct cartridge_header {
 
 void rom_load(char * filename);
 void rom_set_preamble();
+unsigned short rom_get_bank();
 
 #endif
@@ -0,0 +1,30 @@
+#ifndef __TIMELINE_H
+#define __TIMELINE_H
+
+/**
+Scanlines per span in the timeline
+*/
+#define TIMELINE_LINE_BATCH 16
+
+enum timeline_thread {
+	TIMELINE_EMULATOR = 1,
+	TIMELINE_TRACE_WRITER,
+	TIMELINE_RENDER
+};
+
+/**
+Set while a Chrome trace (chrome://tracing, Perfetto) is being written
+*/
+extern char timeline_enabled;
+
+int  timeline_open(char * filename);
+void timeline_close();
+
+unsigned long long timeline_now();
+void timeline_span(const char * name, const char * category,
+	unsigned long long start, unsigned long long end, enum timeline_thread thread);
+
+void timeline_line(unsigned char line);
+void timeline_vblank(char entering);
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include <stdatomic.h>
+
+#define TRACE_MAGIC        "GBTRACE"
+#define TRACE_VERSION      1
+
+/**
+Records held in memory (power of 2) and the most the writer
+thread hands to a single fwrite
+*/
+#define TRACE_BUFFER_SIZE  (1 << 18)
+#define TRACE_WRITE_CHUNK  (1 << 14)
+
+/**
+One executed instruction, registers are from before it ran
+*/
+struct trace_record {
+	unsigned long long cycles;
+	unsigned short pc;
+	unsigned short sp;
+	unsigned short af;
+	unsigned short bc;
+	unsigned short de;
+	unsigned short hl;
+	unsigned char  opcode[3];
+	unsigned char  flag;
+};
+
+struct trace_file_header {
+	char magic[8];
+	unsigned int version;
+	unsigned int record_size;
+};
+
+/**
+Single producer (CPU), single consumer (writer thread) ring
+*/
+struct trace_buffer {
+	char enabled;
+	struct trace_record * records;
+	
+	atomic_ulong head;      // Next record to fill, written by the CPU
+	atomic_ulong tail;      // Next record to write, written by the writer
+	unsigned long limit;    // Producer's cached tail + size
+	
+	unsigned long long stalls;
+};
+
+extern struct trace_buffer trace_buffer;
+
+int  trace_open(char * filename);
+void trace_close();
+void trace_wait();
+
+/**
+	Reserve the next record, fill it, then trace_commit() it
+*/
+static inline struct trace_record * trace_next() {
+	unsigned long head;
+	
+	head = atomic_load_explicit(&trace_buffer.head, memory_order_relaxed);
+	if(head == trace_buffer.limit)
+		trace_wait();
+	return &trace_buffer.records[head & (TRACE_BUFFER_SIZE - 1)];
+}
+static inline void trace_commit() {
+	atomic_fetch_add_explicit(&trace_buffer.head, 1, memory_order_release);
+}
+
+#endif
@@ -4,6 +4,8 @@
 #include "graphics.h"
 #include "interrupt.h"
 #include "rom.h"
+#include "trace.h"
+#include "profiler.h"
 
 /**
 Global variables
@@ -13,27 +15,26 @@ struct cpu_state cpu_state;
 /**
 Static Functions
 */
-static unsigned char parse_opcode(unsigned char opcode);
-static unsigned char parse_prefixed_opcode(unsigned char opcode);
+static unsigned char parse_opcode(struct registers * _regs, unsigned char opcode);
+static unsigned char parse_prefixed_opcode(struct registers * _regs, unsigned char opcode);
 
-static void do_cp(unsigned char val);
+static void do_cp(struct registers * _regs, unsigned char val);
+static unsigned int run_loop_idiom(struct registers * _regs, unsigned long * instructions);
+static void trace_instruction(struct registers * _regs);
 
 /**
 Static Variables
 */
-static struct registers * _regs;
+static int loop_target = -1;
 
 #ifdef DISASSEMBLE
-char disassembly[256];
-short disassembly_pc;
+unsigned short disassembly_pc;
 #endif
 
 /**
 Functions
 */
-void cpu_init() {	
-	_regs = &cpu_state.registers;
-	
+void cpu_init() {
 	cpu_reset();
 }
 
@@ -85,11 +86,11 @@ void cpu_rom_reset() {
 	   [$FFFF] = $00   ; IE
 	*/
 	
-	_regs->AF = 0x01B0;
-	_regs->BC = 0x0013;
-	_regs->DE = 0x00D8;
-	_regs->HL = 0x014D;
-	_regs->SP = 0xFFFE;
+	cpu_state.registers.AF = 0x01B0;
+	cpu_state.registers.BC = 0x0013;
+	cpu_state.registers.DE = 0x00D8;
+	cpu_state.registers.HL = 0x014D;
+	cpu_state.registers.SP = 0xFFFE;
 	
 	memory_write8(0xFF05, 0x00);
 	memory_write8(0xFF06, 0x00);
@@ -125,7 +126,7 @@ void cpu_rom_reset() {
 	
 	rom_set_preamble();
 	
-	_regs->PC = 0x100;
+	cpu_state.registers.PC = 0x100;
 }
 
 struct cpu_state cpu_getState() {
@@ -135,40 +136,96 @@ void cpu_setState(struct cpu_state state) {
 	cpu_state = state;
 }
 
-unsigned char cpu_step() {
-	unsigned char cycles, byte;
-	
-	// Does the preamble need to be loaded
-	// This is only done after bootloader runs
-	if(_regs->PC == 0x100) {
-		rom_set_preamble();
-	}
+unsigned long cpu_step() {
+	// Every instruction takes at least one cycle
+	return cpu_run(1);
+}
 
-	byte = memory_read8(_regs->PC++);
-#ifdef DISASSEMBLE
-	disassembly_pc = _regs->PC - 1;
-	memset(disassembly, 0, sizeof(disassembly));
-#endif
-	cycles = parse_opcode(byte);
-	cpu_state.total_cycles += cycles;
-	
-	// If no cycles, there is a problem
-	if(!cycles)
-		cpu_state.running = 0;
+/**
+	Execute instructions until at least the given number of cycles passed
 	
-	// Update peripherals
-	lcd_update(cycles);
-	graphics_update();
+	The registers live in a local copy while running so they can be kept
+	in host registers. cpu_state.registers is only up to date outside of
+	this function and is synced around interrupt dispatch.
+*/
+unsigned long cpu_run(unsigned long cycles) {
+	struct registers regs;
+	unsigned long elapsed, instructions;
+	unsigned int step, idle;
+	unsigned short pc;
+	unsigned char byte;
 	
-	// Check for interrupts
-	if(cpu_state.ime) {
-		interrupt_handle();
+	PHASE_BEGIN(PHASE_CPU);
+	regs = cpu_state.registers;
+	instructions = 0;
+	for(elapsed = 0; elapsed < cycles && cpu_state.running; elapsed += step) {
+		// Does the preamble need to be loaded
+		// This is only done after bootloader runs
+		if(regs.PC == 0x100) {
+			rom_set_preamble();
+		}
+		
+		if(trace_buffer.enabled) {
+			trace_instruction(&regs);
+		}
+		
+		pc = regs.PC;
+		byte = memory_read8(regs.PC++);
+#ifdef DISASSEMBLE
+		// Text is only produced on demand by disasm()
+		disassembly_pc = regs.PC - 1;
+#endif
+		step = parse_opcode(&regs, byte);
+		cpu_state.total_cycles += step;
+		instructions++;
+#ifdef PROFILE_OPCODES
+		profiler_opcodes[byte].count++;
+		profiler_opcodes[byte].cycles += step;
+#endif
+		
+		// If no cycles, there is a problem
+		if(!step)
+			cpu_state.running = 0;
+		
+		// Update peripherals, the LCD only when its state changes
+		if(cpu_state.total_cycles >= cpu_state.lcd_next_sync) {
+			PHASE_BEGIN(PHASE_LCD);
+			lcd_sync();
+			PHASE_END();
+		}
+		
+		// Check for interrupts
+		if(cpu_state.ime && interrupt_pending()) {
+			PHASE_BEGIN(PHASE_INTERRUPTS);
+			cpu_state.registers = regs;
+			interrupt_handle();
+			regs = cpu_state.registers;
+			PHASE_END();
+		}
+		
+		// Backwards JR NZ may have closed a copy/fill loop
+		// Traces need to see every iteration
+		if(loop_target == regs.PC && !trace_buffer.enabled) {
+			idle = run_loop_idiom(&regs, &instructions);
+			cpu_state.total_cycles += idle;
+			step += idle;
+		}
+		loop_target = -1;
+		
+		// Sampling profiler, never due while disabled
+		if(cpu_state.total_cycles >= profiler_next_sample) {
+			profiler_sample(pc);
+		}
 	}
+	cpu_state.registers = regs;
+	cpu_state.total_instructions += instructions;
+	lcd_sync();
+	PHASE_END();
 	
-	return cycles;
+	return elapsed;
 }
 
-static unsigned char parse_opcode(unsigned char opcode) {
+static unsigned char parse_opcode(struct registers * _regs, unsigned char opcode) {
 	unsigned char cycles;
 	unsigned char tmp_c;
 	unsigned short tmp_s;
@@ -178,60 +235,39 @@ static unsigned char parse_opcode(unsigned char opcode) {
 		case 0x00:
 			// NOP
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "NOP");
-#endif
 			break;
 		case 0x01:
 			// LD BC, nn
 			_regs->BC = memory_read16(_regs->PC);
 			_regs->PC += 2;
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD BC, $%04x", _regs->BC);
-#endif
 			break;
 		case 0x02:
 			// LD (BC), A
 			memory_write8(_regs->BC, _regs->A);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD (BC), A");
-#endif
 			break;
 		case 0x03:
 			// INC BC
 			_regs->BC++;
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "INC BC");
-#endif
 			break;
 		case 0x04:
 			// INC B
 			_regs->B++;
 			_regs->FLAG = FLAG_COMPUTE_INC(_regs->B) | GET_BIT(_regs->FLAG, C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "INC B");
-#endif
 			break;
 		case 0x05:
 			// DEC B
 			_regs->B--;
 			_regs->FLAG = FLAG_COMPUTE_DEC(_regs->B) | GET_BIT(_regs->FLAG, C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "DEC B %d", _regs->B);
-#endif
 			break;
 		case 0x06:
 			// LD B, n
 			_regs->B = memory_read8(_regs->PC++);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD B, $%02x", _regs->B);
-#endif
 			break;
 		case 0x07:
 			// RLCA
@@ -242,9 +278,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			_regs->FLAG |= (tmp_c << C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RLCA");
-#endif
 			break;
 		case 0x08:
 			// LD (nn), SP
@@ -252,9 +285,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->PC += 2;
 			memory_write16(tmp_s, _regs->SP);
 			cycles = 20;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD ($%04x), SP", tmp_s);
-#endif
 			break;
 		case 0x09:
 			// ADD HL, BC
@@ -274,51 +304,33 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << C_FLAG);
 						
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "ADD HL, BC");
-#endif
 			break;
 		case 0x0A:
 			// LD A, (BC)
 			_regs->A = memory_read8(_regs->BC);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD A, (BC)");
-#endif
 			break;
 		case 0x0B:
 			// DEC BC
 			_regs->BC--;
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "DEC BC");
-#endif
 			break;
 		case 0x0C:
 			// INC C
 			_regs->C++;
 			_regs->FLAG = FLAG_COMPUTE_INC(_regs->C) | GET_BIT(_regs->FLAG, C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "INC C");
-#endif
 			break;
 		case 0x0D:
 			// DEC C
 			_regs->C--;
 			_regs->FLAG = FLAG_COMPUTE_DEC(_regs->C) | GET_BIT(_regs->FLAG, C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "DEC C");
-#endif
 			break;
 		case 0x0E:
 			// LD C, n
 			_regs->C = memory_read8(_regs->PC++);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD C, $%02x", _regs->C);
-#endif
 			break;
 		case 0x0F:
 			// RRCA
@@ -328,9 +340,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			_regs->FLAG |= (tmp_c << C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RRCA");
-#endif
 			break;
 
 		
@@ -339,51 +348,33 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->DE = memory_read16(_regs->PC);
 			_regs->PC += 2;
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD DE, $%04x", _regs->DE);
-#endif
 			break;
 		case 0x12:
 			// LD (DE), A
 			memory_write8(_regs->DE, _regs->A);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD (DE), A");
-#endif
 			break;
 		case 0x13:
 			// INC DE
 			_regs->DE++;
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "INC DE");
-#endif
 			break;
 		case 0x14:
 			// INC D
 			_regs->D++;
 			_regs->FLAG = FLAG_COMPUTE_INC(_regs->D) | GET_BIT(_regs->FLAG, C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "INC D");
-#endif
 			break;
 		case 0x15:
 			// DEC D
 			_regs->D--;
 			_regs->FLAG = FLAG_COMPUTE_DEC(_regs->D) | GET_BIT(_regs->FLAG, C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "DEC D");
-#endif
 			break;
 		case 0x16:
 			// LD D, n
 			_regs->D = memory_read8(_regs->PC++);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD D, $%02x", _regs->D);
-#endif
 			break;
 		case 0x17:
 			// RLA
@@ -393,9 +384,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->FLAG = tmp_c;
 			
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RLA");
-#endif
 			break;
 		case 0x18:
 			// JR n
@@ -405,9 +393,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->PC += (signed char)tmp_c;
 			
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "JR %d", tmp_c);
-#endif
 			break;
 		case 0x19:
 			// ADD HL, DE
@@ -427,51 +412,33 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << C_FLAG);
 						
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "ADD HL, DE");
-#endif
 			break;
 		case 0x1A:
 			// LD A, (DE)
 			_regs->A = memory_read8(_regs->DE);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD A, (DE)");
-#endif
 			break;
 		case 0x1B:
 			// DEC DE
 			_regs->DE--;
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "DEC DE");
-#endif
 			break;
 		case 0x1C:
 			// INC E
 			_regs->E++;
 			_regs->FLAG = FLAG_COMPUTE_INC(_regs->E) | GET_BIT(_regs->FLAG, C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "INC E");
-#endif
 			break;
 		case 0x1D:
 			// DEC E
 			_regs->E--;
 			_regs->FLAG = FLAG_COMPUTE_DEC(_regs->E) | GET_BIT(_regs->FLAG, C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "DEC E");
-#endif
 			break;
 		case 0x1E:
 			// LD E, n
 			_regs->E = memory_read8(_regs->PC++);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD E, $%02x", _regs->E);
-#endif
 			break;
 		case 0x1F:
 			// RRA
@@ -482,9 +449,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			_regs->FLAG |= (tmp_s << C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RRA");
-#endif
 			break;
 		
 		case 0x20:
@@ -492,64 +456,49 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			tmp_c = memory_read16(_regs->PC++);
 			
 			// Jump if Z-flag is reset
-			if(!GET_BIT(_regs->FLAG, Z_FLAG))
+			if(!GET_BIT(_regs->FLAG, Z_FLAG)) {
 				_regs->PC += (signed char)tmp_c;
+#ifndef DISASSEMBLE
+				// Trace builds need to see every iteration
+				if((signed char)tmp_c < 0)
+					loop_target = _regs->PC;
+#endif
+			}
 			
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "JR NZ, %02d", tmp_c);
-#endif
 			break;
 		case 0x21:
 			// LD HL, nn
 			_regs->HL = memory_read16(_regs->PC);
 			_regs->PC += 2;
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD HL, $%04x", _regs->HL);
-#endif
 			break;
 		case 0x22:
 			// LD (HL+), A
 			memory_write8(_regs->HL++, _regs->A);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD (HL+), A");
-#endif
 			break;
 		case 0x23:
 			// INC HL
 			_regs->HL++;
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "INC HL");
-#endif
 			break;
 		case 0x24:
 			// INC H
 			_regs->H++;
 			_regs->FLAG = FLAG_COMPUTE_INC(_regs->H) | GET_BIT(_regs->FLAG, C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "INC H");
-#endif
 			break;
 		case 0x25:
 			// DEC H
 			_regs->H--;
 			_regs->FLAG = FLAG_COMPUTE_DEC(_regs->H) | GET_BIT(_regs->FLAG, C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "DEC H");
-#endif
 			break;
 		case 0x26:
 			// LD H, n
 			_regs->H = memory_read8(_regs->PC++);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD H, $%02x", _regs->H);
-#endif
 			break;
 		case 0x28:
 			// JR Z, *
@@ -560,9 +509,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->PC += (signed char)tmp_c;
 			
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "JR Z, %02d", tmp_c);
-#endif
 			break;
 		case 0x29:
 			// ADD HL, HL
@@ -582,60 +528,39 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << C_FLAG);
 						
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "ADD HL, HL");
-#endif
 			break;
 		case 0x2A:
 			// LD A, (HL+)
 			_regs->A = memory_read8(_regs->HL++);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD A, (HL+)");
-#endif
 			break;
 		case 0x2B:
 			// DEC HL
 			_regs->HL--;
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "DEC HL");
-#endif
 			break;
 		case 0x2C:
 			// INC L
 			_regs->L++;
 			_regs->FLAG = FLAG_COMPUTE_INC(_regs->L) | GET_BIT(_regs->FLAG, C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "INC L");
-#endif
 			break;
 		case 0x2D:
 			// DEC L
 			_regs->L--;
 			_regs->FLAG = FLAG_COMPUTE_DEC(_regs->L) | GET_BIT(_regs->FLAG, C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "DEC L");
-#endif
 			break;
 		case 0x2E:
 			// LD L, n
 			_regs->L = memory_read8(_regs->PC++);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD L, $%02x", _regs->L);
-#endif
 			break;
 		case 0x2F:
 			// CPL
 			_regs->A = ~_regs->A;
 			_regs->FLAG |= FLAG_PRECOMPUTE_CPL;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "CPL");
-#endif
 			break;
 		
 		case 0x30:
@@ -647,34 +572,22 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->PC += (signed char)tmp_c;
 			
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "JR NC, %02d", tmp_c);
-#endif
 			break;
 		case 0x31:
 			// LD SP,$aabb
 			_regs->SP = memory_read16(_regs->PC);
 			_regs->PC += 2;
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD SP, $%04x", _regs->SP);
-#endif
 			break;
 		case 0x32:
 			// LD (HL-), A
 			memory_write8(_regs->HL--, _regs->A);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD (HL-), A");
-#endif
 			break;
 		case 0x33:
 			// INC SP
 			_regs->SP++;
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "INC SP");
-#endif
 			break;
 		case 0x34:
 			// INC (HL)
@@ -682,9 +595,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			memory_write8(_regs->HL, tmp_c);
 			_regs->FLAG = FLAG_COMPUTE_INC(tmp_c) | GET_BIT(_regs->FLAG, C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "INC (HL)");
-#endif
 			break;
 		case 0x35:
 			// DEC (HL)
@@ -692,27 +602,18 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			memory_write8(_regs->HL, --tmp_c);
 			_regs->FLAG = FLAG_COMPUTE_DEC(tmp_c) | GET_BIT(_regs->FLAG, C_FLAG);
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "DEC (HL)");
-#endif
 			break;
 		case 0x36:
 			// LD (HL), n
 			tmp_c = memory_read8(_regs->PC++);
 			memory_write8(_regs->HL, tmp_c);
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD (HL), $%04x", tmp_c);
-#endif
 			break;
 		case 0x37:
 			// SCF
 			_regs->FLAG &= (1 << Z_FLAG);
 			_regs->FLAG |= (1 << C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SCF");
-#endif
 			break;
 		case 0x38:
 			// JR C, *
@@ -723,9 +624,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->PC += (signed char)tmp_c;
 			
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "JR C, %02d", tmp_c);
-#endif
 			break;
 		case 0x39:
 			// ADD HL, SP
@@ -745,62 +643,41 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << C_FLAG);
 						
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "ADD HL, SP");
-#endif
 			break;
 		case 0x3A:
 			// LD A, (HL-)
 			tmp_s = memory_read8(_regs->HL--);
 			_regs->A = tmp_s;
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD A, (HL-)");
-#endif
 			break;
 		case 0x3B:
 			// DEC SP
 			_regs->SP--;
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "DEC SP");
-#endif
 			break;
 		case 0x3C:
 			// INC A
 			_regs->A++;
 			_regs->FLAG = FLAG_COMPUTE_INC(_regs->A) | GET_BIT(_regs->FLAG, C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "INC A");
-#endif
 			break;
 		case 0x3D:
 			// DEC A
 			_regs->A--;
 			_regs->FLAG = FLAG_COMPUTE_DEC(_regs->A) | GET_BIT(_regs->FLAG, C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "DEC A");
-#endif
 			break;
 		case 0x3E:
 			// LD A, #
 			_regs->A = memory_read8(_regs->PC++);
 			
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD A, $%02x", _regs->A);
-#endif
 			break;
 		case 0x3F:
 			// CCF
 			_regs->FLAG &= (1 << Z_FLAG);
 			_regs->FLAG ^= (1 << C_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "CCF");
-#endif
 			break;
 		
 		case 0x40:
@@ -808,523 +685,331 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			// Yep. This is a thing
 			_regs->B = _regs->B;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD B, B");
-#endif
 			break;
 		case 0x41:
 			// LD B, C
 			_regs->B = _regs->C;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD B, C");
-#endif
 			break;
 		case 0x42:
 			// LD B, D
 			_regs->B = _regs->D;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD B, D");
-#endif
 			break;
 		case 0x43:
 			// LD B, E
 			_regs->B = _regs->E;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD B, E");
-#endif
 			break;
 		case 0x44:
 			// LD B, H
 			_regs->B = _regs->H;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD B, H");
-#endif
 			break;
 		case 0x45:
 			// LD B, L
 			_regs->B = _regs->L;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD B, L");
-#endif
 			break;
 		case 0x46:
 			// LD B, (HL)
 			tmp_c = memory_read8(_regs->HL);
 			_regs->B = tmp_c;
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD B, (HL)");
-#endif
 			break;
 		case 0x47:
 			// LD B, A
 			_regs->B = _regs->A;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD B, A");
-#endif
 			break;
 		case 0x48:
 			// LD C, B
 			_regs->C = _regs->B;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD C, B");
-#endif
 			break;
 		case 0x49:
 			// LD C, C
 			_regs->C = _regs->C;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD C, C");
-#endif
 			break;
 		case 0x4A:
 			// LD C, D
 			_regs->C = _regs->D;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD C, D");
-#endif
 			break;
 		case 0x4B:
 			// LD C, E
 			_regs->C = _regs->E;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD C, E");
-#endif
 			break;
 		case 0x4C:
 			// LD C, H
 			_regs->C = _regs->H;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD C, H");
-#endif
 			break;
 		case 0x4D:
 			// LD C, L
 			_regs->C = _regs->L;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD C, L");
-#endif
 			break;
 		case 0x4E:
 			// LD C, (HL)
 			tmp_c = memory_read8(_regs->HL);
 			_regs->C = tmp_c;
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD C, (HL)");
-#endif
 			break;
 		case 0x4F:
 			// LD C, A
 			_regs->C = _regs->A;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD C, A");
-#endif
 			break;
 
 		case 0x50:
 			// LD D, B
 			_regs->D = _regs->B;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD D, B");
-#endif
 			break;
 		case 0x51:
 			// LD D, C
 			_regs->D = _regs->C;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD D, C");
-#endif
 			break;
 		case 0x52:
 			// LD D, D
 			_regs->D = _regs->D;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD D, D");
-#endif
 			break;
 		case 0x53:
 			// LD D, E
 			_regs->D = _regs->E;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD D, E");
-#endif
 			break;
 		case 0x54:
 			// LD D, H
 			_regs->D = _regs->H;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD D, H");
-#endif
 			break;
 		case 0x55:
 			// LD D, L
 			_regs->D = _regs->L;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD D, L");
-#endif
 			break;
 		case 0x56:
 			// LD D, (HL)
 			tmp_c = memory_read8(_regs->HL);
 			_regs->D = tmp_c;
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD D, (HL)");
-#endif
 			break;
 		case 0x57:
 			// LD D, A
 			_regs->D = _regs->A;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD D, A");
-#endif
 			break;
 		case 0x58:
 			// LD E, B
 			_regs->E = _regs->B;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD E, B");
-#endif
 			break;
 		case 0x59:
 			// LD E, C
 			_regs->E = _regs->C;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD E, C");
-#endif
 			break;
 		case 0x5A:
 			// LD E, D
 			_regs->E = _regs->D;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD E, D");
-#endif
 			break;
 		case 0x5B:
 			// LD E, E
 			_regs->E = _regs->E;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD E, E");
-#endif
 			break;
 		case 0x5C:
 			// LD E, H
 			_regs->E = _regs->H;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD E, H");
-#endif
 			break;
 		case 0x5D:
 			// LD E, L
 			_regs->E = _regs->L;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD E, L");
-#endif
 			break;
 		case 0x5E:
 			// LD E, (HL)
 			tmp_c = memory_read8(_regs->HL);
 			_regs->E = tmp_c;
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD E, (HL)");
-#endif
 			break;
 		case 0x5F:
 			// LD E, A
 			_regs->E = _regs->A;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD E, A");
-#endif
 			break;
 		
 		case 0x60:
 			// LD H, B
 			_regs->H = _regs->B;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD H, B");
-#endif
 			break;
 		case 0x61:
 			// LD H, C
 			_regs->H = _regs->C;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD H, C");
-#endif
 			break;
 		case 0x62:
 			// LD H, D
 			_regs->H = _regs->D;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD H, D");
-#endif
 			break;
 		case 0x63:
 			// LD H, E
 			_regs->H = _regs->E;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD H, E");
-#endif
 			break;
 		case 0x64:
 			// LD H, H
 			_regs->H = _regs->H;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD H, H");
-#endif
 			break;
 		case 0x65:
 			// LD H, L
 			_regs->H = _regs->L;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD H, L");
-#endif
 			break;
 		case 0x66:
 			// LD H, (HL)
 			tmp_c = memory_read8(_regs->HL);
 			_regs->H = tmp_c;
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD H, (HL)");
-#endif
 			break;
 		case 0x67:
 			// LD H, A
 			_regs->H = _regs->A;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD H, A");
-#endif
 			break;
 		case 0x68:
 			// LD L, B
 			_regs->L = _regs->B;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD L, B");
-#endif
 			break;
 		case 0x69:
 			// LD L, C
 			_regs->L = _regs->C;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD L, C");
-#endif
 			break;
 		case 0x6A:
 			// LD L, D
 			_regs->L = _regs->D;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD L, D");
-#endif
 			break;
 		case 0x6B:
 			// LD L, E
 			_regs->L = _regs->E;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD L, E");
-#endif
 			break;
 		case 0x6C:
 			// LD L, H
 			_regs->L = _regs->H;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD L, H");
-#endif
 			break;
 		case 0x6D:
 			// LD L, L
 			_regs->L = _regs->L;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD L, L");
-#endif
 			break;
 		case 0x6E:
 			// LD L, (HL)
 			tmp_c = memory_read8(_regs->HL);
 			_regs->L = tmp_c;
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD L, (HL)");
-#endif
 			break;
 		case 0x6F:
 			// LD L, A
 			_regs->L = _regs->A;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD L, A");
-#endif
 			break;
 		
 		case 0x70:
 			// LD (HL), B
 			memory_write8(_regs->HL, _regs->B);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD (HL), B");
-#endif
 			break;
 		case 0x71:
 			// LD (HL), C
 			memory_write8(_regs->HL, _regs->C);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD (HL), C");
-#endif
 			break;
 		case 0x72:
 			// LD (HL), D
 			memory_write8(_regs->HL, _regs->D);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD (HL), D");
-#endif
 			break;
 		case 0x73:
 			// LD (HL), E
 			memory_write8(_regs->HL, _regs->E);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD (HL), E");
-#endif
 			break;
 		case 0x74:
 			// LD (HL), H
 			memory_write8(_regs->HL, _regs->H);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD (HL), H");
-#endif
 			break;
 		case 0x75:
 			// LD (HL), L
 			memory_write8(_regs->HL, _regs->L);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD (HL), L");
-#endif
 			break;
 		case 0x76:
 			// HALT
 			// TODO: Implement logic
 			cpu_state.halt = 1;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "HALT");
-#endif
 			break;
 		case 0x77:
 			// LD (HL), A
 			memory_write8(_regs->HL, _regs->A);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD (HL), A");
-#endif
 			break;
 		case 0x78:
 			// LD A, B
 			_regs->A = _regs->B;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD A, B");
-#endif
 			break;
 		case 0x79:
 			// LD A, C
 			_regs->A = _regs->C;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD A, C");
-#endif
 			break;
 		case 0x7A:
 			// LD A, D
 			_regs->A = _regs->D;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD A, D");
-#endif
 			break;
 		case 0x7B:
 			// LD A, E
 			_regs->A = _regs->E;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD A, E");
-#endif
 			break;
 		case 0x7C:
 			// LD A, H
 			_regs->A = _regs->H;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD A, H");
-#endif
 			break;
 		case 0x7D:
 			// LD A, L
 			_regs->A = _regs->L;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD A, L");
-#endif
 			break;
 		case 0x7E:
 			// LD A, (HL)
 			_regs->A = memory_read8(_regs->HL);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD A, (HL)");
-#endif
 			break;
 		case 0x7F:
 			// LD A, A
 			_regs->A = _regs->A;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD A, A");
-#endif
 			break;
 		
 		case 0x80:
@@ -1344,9 +1029,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 			
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "ADD A, B");
-#endif
 			break;
 		case 0x81:
 			// ADD A, C
@@ -1365,9 +1047,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 			
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "ADD A, C");
-#endif
 			break;
 		case 0x82:
 			// ADD A, D
@@ -1386,9 +1065,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 			
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "ADD A, B");
-#endif
 			break;
 		case 0x83:
 			// ADD A, E
@@ -1407,9 +1083,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 			
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "ADD A, E");
-#endif
 			break;
 		case 0x84:
 			// ADD A, H
@@ -1428,9 +1101,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 			
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "ADD A, H");
-#endif
 			break;
 		case 0x85:
 			// ADD A, L
@@ -1449,9 +1119,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 			
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "ADD A, L");
-#endif
 			break;
 		case 0x86:
 			// ADD A, (HL)
@@ -1471,9 +1138,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 			
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "ADD A, (HL)");
-#endif
 			break;
 		case 0x87:
 			// ADD A, A
@@ -1492,9 +1156,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 			
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "ADD A, A");
-#endif
 			break;
 
 		case 0x90:
@@ -1515,9 +1176,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 					
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SUB B");
-#endif			
 			break;
 		case 0x91:
 			// SUB C
@@ -1537,9 +1195,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 					
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SUB C");
-#endif			
 			break;
 		case 0x92:
 			// SUB D
@@ -1559,9 +1214,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 					
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SUB D");
-#endif			
 			break;
 		case 0x93:
 			// SUB E
@@ -1581,9 +1233,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 					
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SUB E");
-#endif			
 			break;
 		case 0x94:
 			// SUB H
@@ -1603,9 +1252,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 					
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SUB H");
-#endif			
 			break;
 		case 0x95:
 			// SUB L
@@ -1625,9 +1271,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 					
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SUB L");
-#endif			
 			break;
 		case 0x96:
 			// SUB (HL)
@@ -1648,9 +1291,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 			
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SUB C");
-#endif			
 			break;
 		case 0x98:
 			// SBC A, B
@@ -1672,9 +1312,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 					
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SBC A, B");
-#endif			
 			break;
 		case 0x99:
 			// SBC A, C
@@ -1696,9 +1333,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 					
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SBC A, C");
-#endif			
 			break;
 		case 0x9A:
 			// SBC A, D
@@ -1720,9 +1354,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 					
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SBC A, D");
-#endif			
 			break;
 		case 0x9B:
 			// SBC A, E
@@ -1744,9 +1375,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 					
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SBC A, E");
-#endif			
 			break;
 		case 0x9C:
 			// SBC A, H
@@ -1768,9 +1396,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 					
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SBC A, H");
-#endif			
 			break;
 		case 0x9D:
 			// SBC A, L
@@ -1792,9 +1417,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 					
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SBC A, L");
-#endif			
 			break;
 		case 0x9E:
 			// SBC A, B
@@ -1817,9 +1439,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 					
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SBC A, $%02x", tmp_c);
-#endif			
 			break;
 
 		case 0xA0:
@@ -1827,54 +1446,36 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->A &= _regs->B;
 			_regs->FLAG = FLAG_COMPUTE_AND(_regs->A);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "AND B");
-#endif
 			break;
 		case 0xA1:
 			// AND C
 			_regs->A &= _regs->C;
 			_regs->FLAG = FLAG_COMPUTE_AND(_regs->A);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "AND C");
-#endif
 			break;
 		case 0xA2:
 			// AND D
 			_regs->A &= _regs->D;
 			_regs->FLAG = FLAG_COMPUTE_AND(_regs->A);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "AND D");
-#endif
 			break;
 		case 0xA3:
 			// AND E
 			_regs->A &= _regs->E;
 			_regs->FLAG = FLAG_COMPUTE_AND(_regs->A);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "AND E");
-#endif
 			break;
 		case 0xA4:
 			// AND H
 			_regs->A &= _regs->H;
 			_regs->FLAG = FLAG_COMPUTE_AND(_regs->A);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "AND H");
-#endif
 			break;
 		case 0xA5:
 			// AND L
 			_regs->A &= _regs->L;
 			_regs->FLAG = FLAG_COMPUTE_AND(_regs->A);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "AND L");
-#endif
 			break;
 		case 0xA6:
 			// AND (HL)
@@ -1882,90 +1483,60 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->A &= tmp_c;
 			_regs->FLAG = FLAG_COMPUTE_AND(_regs->A);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "AND (HL)");
-#endif
 			break;
 		case 0xA7:
 			// AND A
 			_regs->A &= _regs->A;
 			_regs->FLAG = FLAG_COMPUTE_AND(_regs->A);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "AND A");
-#endif
 			break;
 		case 0xA8:
 			// XOR B
 			_regs->A ^= _regs->B;
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "XOR B");
-#endif
 			break;
 		case 0xA9:
 			// XOR C
 			_regs->A ^= _regs->C;
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "XOR C");
-#endif
 			break;
 		case 0xAA:
 			// XOR D
 			_regs->A ^= _regs->D;
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "XOR D");
-#endif
 			break;
 		case 0xAB:
 			// XOR E
 			_regs->A ^= _regs->E;
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "XOR E");
-#endif
 			break;
 		case 0xAC:
 			// XOR H
 			_regs->A ^= _regs->H;
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "XOR H");
-#endif
 			break;
 		case 0xAD:
 			// XOR L
 			_regs->A ^= _regs->L;
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "XOR L");
-#endif
 			break;
 		case 0xAE:
 			// XOR (HL)
 			_regs->A ^= memory_read16(_regs->HL);
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "XOR (HL)");
-#endif
 			break;
 		case 0xAF:
 			// XOR A
 			_regs->A ^= _regs->A;
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "XOR A");
-#endif
 			break;
 		
 		case 0xB0:
@@ -1974,19 +1545,13 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "OR B");
-#endif
 			break;
 		case 0xB1:
-			// OR B
-			_regs->A |= _regs->B;
+			// OR C
+			_regs->A |= _regs->C;
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "OR B");
-#endif
 			break;
 		case 0xB2:
 			// OR D
@@ -1994,9 +1559,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "OR D");
-#endif
 			break;
 		case 0xB3:
 			// OR E
@@ -2004,9 +1566,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "OR E");
-#endif
 			break;
 		case 0xB4:
 			// OR H
@@ -2014,9 +1573,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "OR H");
-#endif
 			break;
 		case 0xB5:
 			// OR L
@@ -2024,9 +1580,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "OR L");
-#endif
 			break;
 		case 0xB6:
 			// OR (HL)
@@ -2034,9 +1587,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "OR (HL)");
-#endif
 			break;
 		case 0xB7:
 			// OR A
@@ -2044,74 +1594,47 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "OR A");
-#endif
 			break;
 		case 0xB8:
 			// CP B
-			do_cp(_regs->B);
+			do_cp(_regs, _regs->B);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "CP B");
-#endif
 			break;
 		case 0xB9:
 			// CP C
-			do_cp(_regs->C);
+			do_cp(_regs, _regs->C);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "CP C");
-#endif
 			break;
 		case 0xBA:
 			// CP D
-			do_cp(_regs->D);
+			do_cp(_regs, _regs->D);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "CP D");
-#endif
 			break;
 		case 0xBB:
 			// CP E
-			do_cp(_regs->E);
+			do_cp(_regs, _regs->E);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "CP E");
-#endif
 			break;
 		case 0xBC:
 			// CP H
-			do_cp(_regs->H);
+			do_cp(_regs, _regs->H);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "CP H");
-#endif
 			break;
 		case 0xBD:
 			// CP L
-			do_cp(_regs->L);
+			do_cp(_regs, _regs->L);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "CP L");
-#endif
 			break;
 		case 0xBE:
 			// CP (HL)
 			tmp_c = memory_read8(_regs->HL);
-			do_cp(tmp_c);
+			do_cp(_regs, tmp_c);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "CP (HL)");
-#endif
 			break;
 		case 0xBF:
 			// CP A
-			do_cp(_regs->A);
+			do_cp(_regs, _regs->A);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "CP A");
-#endif
 			break;
 
 		case 0xC0:
@@ -2119,20 +1642,16 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			if(!(_regs->FLAG >> Z_FLAG)) {
 				_regs->PC = memory_read16(_regs->SP);
 				_regs->SP += 2;
+				if(profiler_callgraph)
+					profiler_return(_regs->SP);
 			}
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RET NZ");
-#endif
 			break;
 		case 0xC1:
 			// POP BC
 			_regs->BC = memory_read16(_regs->SP);
 			_regs->SP += 2;
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "POP BC");
-#endif
 			break;
 		case 0xC2:
 			// JP NZ, nn
@@ -2142,36 +1661,26 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->PC = tmp_s;
 			}
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "JP NZ, $%4x", tmp_s);
-#endif
 			break;
 		case 0xC3:
 			// JP nn
 			_regs->PC = memory_read16(_regs->PC);
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "JP $%04x", _regs->PC);
-#endif
 			break;
 		case 0xC9:
 			// RET
 			// POP Ret Addr
 			_regs->PC = memory_read16(_regs->SP);
 			_regs->SP += 2;
+			if(profiler_callgraph)
+				profiler_return(_regs->SP);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RET: $%04x", _regs->PC);
-#endif
 			break;
 		case 0xC5:
 			// PUSH BC
 			_regs->SP -= 2;
 			memory_write16(_regs->SP, _regs->BC);
 			cycles = 16;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "PUSH BC");
-#endif
 			break;
 		case 0xC6:
 			// ADD A, #
@@ -2191,30 +1700,25 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 			
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "ADD A, $%02x", tmp_c);
-#endif
 			break;
 		case 0xC7:
 			// RST 0x00
 			_regs->SP -= 2;
 			memory_write16(_regs->SP, _regs->PC);
 			_regs->PC = 0x00;
+			if(profiler_callgraph)
+				profiler_call(_regs->PC, _regs->SP);
 			cycles = 32;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RST $00");
-#endif
 			break;
 		case 0xC8:
 			// RET Z
 			if(_regs->FLAG >> Z_FLAG) {
 				_regs->PC = memory_read16(_regs->SP);
 				_regs->SP += 2;
+				if(profiler_callgraph)
+					profiler_return(_regs->SP);
 			}
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RET Z");
-#endif
 			break;
 		case 0xCA:
 			// JP Z, nn
@@ -2224,14 +1728,15 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->PC = tmp_s;
 			}
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "JP Z, $%4x", tmp_s);
-#endif
 			break;
 		case 0xCB:
 			// Prefixed opcode
 			opcode = memory_read8(_regs->PC++);
-			cycles = parse_prefixed_opcode(opcode);
+			cycles = parse_prefixed_opcode(_regs, opcode);
+#ifdef PROFILE_OPCODES
+			profiler_opcodes[0x100 | opcode].count++;
+			profiler_opcodes[0x100 | opcode].cycles += cycles;
+#endif
 			break;
 		case 0xCD:
 			// Call nn
@@ -2244,21 +1749,19 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			
 			// Jump
 			_regs->PC = tmp_s;
+			if(profiler_callgraph)
+				profiler_call(_regs->PC, _regs->SP);
 			
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "CALL $%04x", tmp_s);
-#endif
 			break;
 		case 0xCF:
 			// RST 0x08
 			_regs->SP -= 2;
 			memory_write16(_regs->SP, _regs->PC);
 			_regs->PC = 0x08;
+			if(profiler_callgraph)
+				profiler_call(_regs->PC, _regs->SP);
 			cycles = 32;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RST $08");
-#endif
 			break;
 		
 		case 0xD0:
@@ -2266,20 +1769,16 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			if(!((_regs->FLAG >> C_FLAG) & 0x1)) {
 				_regs->PC = memory_read16(_regs->SP);
 				_regs->SP += 2;
+				if(profiler_callgraph)
+					profiler_return(_regs->SP);
 			}
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RET NC");
-#endif
 			break;
 		case 0xD1:
 			// POP DE
 			_regs->DE = memory_read16(_regs->SP);
 			_regs->SP += 2;
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "POP DE");
-#endif
 			break;
 		case 0xD2:
 			// JP NC, nn
@@ -2289,18 +1788,12 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->PC = tmp_s;
 			}
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "JP NC, $%4x", tmp_s);
-#endif
 			break;
 		case 0xD5:
 			// PUSH DE
 			_regs->SP -= 2;
 			memory_write16(_regs->SP, _regs->DE);
 			cycles = 16;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "PUSH DE");
-#endif
 			break;
 		case 0xD6:
 			// SUB #
@@ -2321,44 +1814,38 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 					
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SUB $%02x", tmp_c);
-#endif			
 			break;
 		case 0xD7:
 			// RST 0x10
 			_regs->SP -= 2;
 			memory_write16(_regs->SP, _regs->PC);
 			_regs->PC = 0x10;
+			if(profiler_callgraph)
+				profiler_call(_regs->PC, _regs->SP);
 			cycles = 32;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RST $10");
-#endif
 			break;
 		case 0xD8:
 			// RET C
 			if((_regs->FLAG >> C_FLAG) & 0x1) {
 				_regs->PC = memory_read16(_regs->SP);
 				_regs->SP += 2;
+				if(profiler_callgraph)
+					profiler_return(_regs->SP);
 			}
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RET C");
-#endif
 			break;
 		case 0xD9:
 			// RETI
 			// POP Ret Addr
 			_regs->PC = memory_read16(_regs->SP);
 			_regs->SP += 2;
+			if(profiler_callgraph)
+				profiler_return(_regs->SP);
 			
 			// Enable interrupts
 			cpu_state.ime = 1;
 			
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RETI: $%04x", _regs->PC);
-#endif
 			break;
 		case 0xDA:
 			// JP C, nn
@@ -2368,9 +1855,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->PC = tmp_s;
 			}
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "JP C, $%4x", tmp_s);
-#endif
 			break;
 		case 0xDE:
 		//
@@ -2395,19 +1879,15 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 					
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SBC A, $%04x", tmp_s);
-#endif			
 			break;
 		case 0xDF:
 			// RST 0x18
 			_regs->SP -= 2;
 			memory_write16(_regs->SP, _regs->PC);
 			_regs->PC = 0x18;
+			if(profiler_callgraph)
+				profiler_call(_regs->PC, _regs->SP);
 			cycles = 32;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RST $18");
-#endif
 			break;
 
 		case 0xE0:
@@ -2415,35 +1895,23 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			tmp_c = memory_read8(_regs->PC++);
 			memory_write8(0xFF00 + tmp_c, _regs->A);
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD ($FF00 + $%02x), A", tmp_c);
-#endif
 			break;
 		case 0xE1:
 			// POP HL
 			_regs->HL = memory_read16(_regs->SP);
 			_regs->SP += 2;
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "POP HL");
-#endif
 			break;
 		case 0xE2:
 			// LD ($FF00 + C), A
 			memory_write8(0xFF00 + _regs->C, _regs->A);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD ($FF00 + C), A");
-#endif
 			break;
 		case 0xE5:
 			// PUSH HL
 			_regs->SP -= 2;
 			memory_write16(_regs->SP, _regs->HL);
 			cycles = 16;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "PUSH HL");
-#endif
 			break;
 		case 0xE6:
 			// AND #
@@ -2451,27 +1919,20 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->A &= tmp_c;
 			_regs->FLAG = FLAG_COMPUTE_AND(_regs->A);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "AND $%02x", tmp_c);
-#endif
 			break;
 		case 0xE7:
 			// RST 0x20
 			_regs->SP -= 2;
 			memory_write16(_regs->SP, _regs->PC);
 			_regs->PC = 0x20;
+			if(profiler_callgraph)
+				profiler_call(_regs->PC, _regs->SP);
 			cycles = 32;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RST $20");
-#endif
 			break;
 		case 0xE9:
 			// JP (HL)
 			_regs->PC = memory_read16(_regs->HL);
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "JP (HL)");
-#endif
 			break;
 		case 0xEA:
 			// LD (nn), A
@@ -2481,19 +1942,15 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			memory_write16(tmp_s, _regs->A);
 			
 			cycles = 16;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD ($%04x), A", tmp_s);
-#endif
 			break;
 		case 0xEF:
 			// RST 0x28
 			_regs->SP -= 2;
 			memory_write16(_regs->SP, _regs->PC);
 			_regs->PC = 0x28;
+			if(profiler_callgraph)
+				profiler_call(_regs->PC, _regs->SP);
 			cycles = 32;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RST $28");
-#endif
 			break;
 		
 		case 0xF0:
@@ -2502,9 +1959,6 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->A = memory_read8(0xFF00 + tmp_c);
 			
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD A,($FF00 + $%02x)", tmp_c);
-#endif
 			break;
 		case 0xF1:
 			// POP AF
@@ -2512,36 +1966,26 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->PC += 2;
 			
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "POP AF");
-#endif
 			break;
 		case 0xF3:
 			// DI - Disable Interrupts
 			cpu_state.ime = 0;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "DI");
-#endif
 			break;
 		case 0xF5:
 			// PUSH AF
 			_regs->SP -= 2;
 			memory_write16(_regs->SP, _regs->AF);
 			cycles = 16;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "PUSH AF");
-#endif
 			break;
 		case 0xF7:
 			// RST 0x30
 			_regs->SP -= 2;
 			memory_write16(_regs->SP, _regs->PC);
 			_regs->PC = 0x30;
+			if(profiler_callgraph)
+				profiler_call(_regs->PC, _regs->SP);
 			cycles = 32;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RST $30");
-#endif
 			break;
 		case 0xF8:
 			// LD HL, (SP+n)
@@ -2561,17 +2005,11 @@ static unsigned char parse_opcode(unsigned char opcode) {
 				_regs->FLAG |= (1 << H_FLAG);
 			
 			cycles = 12;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LDHL SP, n");
-#endif
 			break;
 		case 0xF9:
 			// LD SP, HL
 			_regs->SP = _regs->HL;
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD SP, HL");
-#endif
 			break;
 		case 0xFA:
 			// LD A, (nn)
@@ -2581,25 +2019,16 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->A = memory_read8(tmp_s);
 			
 			cycles = 16;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "LD A, ($%04x)", tmp_s);
-#endif
 			break;
 		case 0xFB:
 			// EI
 			cpu_state.ime = 1;
 			cycles = 4;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "EI");
-#endif
 			break;
 		case 0xFE:
 			// CP n
 			tmp_c = memory_read8(_regs->PC++);
-			do_cp(tmp_c);
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "CP $%02x $%02x", tmp_c, _regs->A);
-#endif		
+			do_cp(_regs, tmp_c);
 			cycles = 8;
 			break;
 		case 0xFF:
@@ -2607,16 +2036,12 @@ static unsigned char parse_opcode(unsigned char opcode) {
 			_regs->SP -= 2;
 			memory_write16(_regs->SP, _regs->PC);
 			_regs->PC = 0x38;
+			if(profiler_callgraph)
+				profiler_call(_regs->PC, _regs->SP);
 			cycles = 32;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RST $38");
-#endif
 			break;
 		
 		default:
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "Unimplemented: 0x%02x", opcode);
-#endif
 			_regs->PC--;
 			cycles = 0;
 	}
@@ -2624,7 +2049,7 @@ static unsigned char parse_opcode(unsigned char opcode) {
 	return cycles;
 }
 
-static unsigned char parse_prefixed_opcode(unsigned char opcode) {
+static unsigned char parse_prefixed_opcode(struct registers * _regs, unsigned char opcode) {
 	unsigned char cycles;
 	unsigned char tmp_c;
 	unsigned short tmp_s;
@@ -2645,9 +2070,6 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			_regs->FLAG = (((!_regs->B) << Z_FLAG) | tmp_c);
 			
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RL B");
-#endif
 			break;
 		case 0x11:
 			// RL C
@@ -2659,9 +2081,6 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			_regs->FLAG = (((!_regs->C) << Z_FLAG) | tmp_c);
 			
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RL C");
-#endif
 			break;
 		case 0x12:
 			// RL D
@@ -2673,9 +2092,6 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			_regs->FLAG = (((!_regs->D) << Z_FLAG) | tmp_c);
 			
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RL D");
-#endif
 			break;
 		case 0x13:
 			// RL E
@@ -2687,9 +2103,6 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			_regs->FLAG = (((!_regs->E) << Z_FLAG) | tmp_c);
 			
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RL E");
-#endif
 			break;
 		case 0x14:
 			// RL H
@@ -2701,9 +2114,6 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			_regs->FLAG = (((!_regs->H) << Z_FLAG) | tmp_c);
 			
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RL C");
-#endif
 			break;
 		case 0x15:
 			// RL L
@@ -2715,9 +2125,6 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			_regs->FLAG = (((!_regs->L) << Z_FLAG) | tmp_c);
 			
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RL L");
-#endif
 			break;
 		case 0x17:
 			// RL A
@@ -2729,9 +2136,6 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			_regs->FLAG = (((!_regs->A) << Z_FLAG) | tmp_c);
 			
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "RL A");
-#endif
 			break;
 		
 		case 0x30:
@@ -2740,9 +2144,6 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			_regs->B = ((tmp_c & 0xF)<<4 | (tmp_c & 0xF0)>>4);
 			_regs->FLAG = (_regs->B ? 0 : 1<<Z_FLAG);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SWAP B");
-#endif
 			break;
 		case 0x31:
 			// SWAP C
@@ -2750,9 +2151,6 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			_regs->C = ((tmp_c & 0xF)<<4 | (tmp_c & 0xF0)>>4);
 			_regs->FLAG = (_regs->C ? 0 : 1<<Z_FLAG);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SWAP C");
-#endif
 			break;
 		case 0x32:
 			// SWAP D
@@ -2760,9 +2158,6 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			_regs->D = ((tmp_c & 0xF)<<4 | (tmp_c & 0xF0)>>4);
 			_regs->FLAG = (_regs->D ? 0 : 1<<Z_FLAG);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SWAP D");
-#endif
 			break;
 		case 0x33:
 			// SWAP E
@@ -2770,9 +2165,6 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			_regs->E = ((tmp_c & 0xF)<<4 | (tmp_c & 0xF0)>>4);
 			_regs->FLAG = (_regs->E ? 0 : 1<<Z_FLAG);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SWAP E");
-#endif
 			break;
 		case 0x34:
 			// SWAP H
@@ -2780,9 +2172,6 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			_regs->H = ((tmp_c & 0xF)<<4 | (tmp_c & 0xF0)>>4);
 			_regs->FLAG = (_regs->H ? 0 : 1<<Z_FLAG);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SWAP H");
-#endif
 			break;
 		case 0x35:
 			// SWAP L
@@ -2790,9 +2179,6 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			_regs->L = ((tmp_c & 0xF)<<4 | (tmp_c & 0xF0)>>4);
 			_regs->FLAG = (_regs->L ? 0 : 1<<Z_FLAG);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SWAP L");
-#endif
 			break;
 		case 0x36:
 			// SWAP (HL)
@@ -2801,9 +2187,6 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			memory_write8(_regs->HL, tmp_c);
 			_regs->FLAG = (tmp_c ? 0 : 1<<Z_FLAG);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SWAP (HL)");
-#endif
 			break;
 		case 0x37:
 			// SWAP A
@@ -2811,303 +2194,192 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			_regs->A = ((tmp_c & 0xF)<<4 | (tmp_c & 0xF0)>>4);
 			_regs->FLAG = (_regs->A ? 0 : 1<<Z_FLAG);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SWAP A");
-#endif
 			break;
 		
 		case 0x60:
 			// BIT 4, B
 			DO_BITS_OPCODE(_regs->B, 4);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 4, B");
-#endif
 			break;
 		case 0x61:
 			// BIT 4, C
 			DO_BITS_OPCODE(_regs->C, 4);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 4, C");
-#endif
 			break;
 		case 0x62:
 			// BIT 4, D
 			DO_BITS_OPCODE(_regs->D, 4);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 4, D");
-#endif
 			break;
 		case 0x63:
 			// BIT 4, E
 			DO_BITS_OPCODE(_regs->E, 4);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 4, E");
-#endif
 			break;
 		case 0x64:
 			// BIT 4, H
 			DO_BITS_OPCODE(_regs->H, 4);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 4, H");
-#endif
 			break;
 		case 0x65:
 			// BIT 4, L
 			DO_BITS_OPCODE(_regs->L, 4);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 4, L");
-#endif
 			break;
 		case 0x66:
 			// BIT 4, (HL)
 			tmp_c = memory_read8(_regs->HL);
 			DO_BITS_OPCODE(tmp_c, 4);
 			cycles = 16;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 4, (HL)");
-#endif
 			break;
 		case 0x67:
 			// BIT 4, A
 			DO_BITS_OPCODE(_regs->A, 4);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 4, A");
-#endif
 			break;
 		case 0x68:
 			// BIT 5, B
 			DO_BITS_OPCODE(_regs->B, 5);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 5, B");
-#endif
 			break;
 		case 0x69:
 			// BIT 5, C
 			DO_BITS_OPCODE(_regs->C, 5);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 5, C");
-#endif
 			break;
 		case 0x6A:
 			// BIT 5, D
 			DO_BITS_OPCODE(_regs->D, 5);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 5, D");
-#endif
 			break;
 		case 0x6B:
 			// BIT 5, E
 			DO_BITS_OPCODE(_regs->E, 5);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 5, E");
-#endif
 			break;
 		case 0x6C:
 			// BIT 5, H
 			DO_BITS_OPCODE(_regs->H, 5);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 5, H");
-#endif
 			break;
 		case 0x6D:
 			// BIT 5, L
 			DO_BITS_OPCODE(_regs->L, 5);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 5, L");
-#endif
 			break;
 		case 0x6E:
 			// BIT 5, (HL)
 			tmp_c = memory_read8(_regs->HL);
 			DO_BITS_OPCODE(tmp_c, 5);
 			cycles = 16;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 5, (HL)");
-#endif
 			break;
 		case 0x6F:
 			// BIT 5, A
 			DO_BITS_OPCODE(_regs->A, 5);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 5, A");
-#endif
 			break;
 
 		case 0x70:
 			// BIT 6, B
 			DO_BITS_OPCODE(_regs->B, 6);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 7, B");
-#endif
 			break;
 		case 0x71:
 			// BIT 6, C
 			DO_BITS_OPCODE(_regs->C, 6);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 6, C");
-#endif
 			break;
 		case 0x72:
 			// BIT 6, D
 			DO_BITS_OPCODE(_regs->D, 6);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 6, D");
-#endif
 			break;
 		case 0x73:
 			// BIT 6, E
 			DO_BITS_OPCODE(_regs->E, 6);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 6, E");
-#endif
 			break;
 		case 0x74:
 			// BIT 6, H
 			DO_BITS_OPCODE(_regs->H, 6);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 6, H");
-#endif
 			break;
 		case 0x75:
 			// BIT 6, L
 			DO_BITS_OPCODE(_regs->L, 6);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 6, L");
-#endif
 			break;
 		case 0x77:
 			// BIT 6, A
 			DO_BITS_OPCODE(_regs->A, 6);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 6, A");
-#endif
 			break;
 		case 0x78:
 			// BIT 7, B
 			DO_BITS_OPCODE(_regs->B, 7);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 7, B");
-#endif
 			break;
 		case 0x79:
 			// BIT 7, C
 			DO_BITS_OPCODE(_regs->C, 7);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 7, C");
-#endif
 			break;
 		case 0x7A:
 			// BIT 7, D
 			DO_BITS_OPCODE(_regs->D, 7);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 7, D");
-#endif
 			break;
 		case 0x7B:
 			// BIT 7, E
 			DO_BITS_OPCODE(_regs->E, 7);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 7, E");
-#endif
 			break;
 		case 0x7C:
 			// BIT 7, H
 			DO_BITS_OPCODE(_regs->H, 7);;
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 7, H");
-#endif
 			break;
 		case 0x7D:
 			// BIT 7, (HL)
 			tmp_c = memory_read8(_regs->HL);
 			DO_BITS_OPCODE(tmp_c, 7);
 			cycles = 16;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 7, (HL)");
-#endif
 			break;
 		case 0x7F:
 			// BIT 7, A
 			DO_BITS_OPCODE(_regs->A, 7);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "BIT 7, A");
-#endif
 			break;
 
 		case 0xC0:
 			// SET 0, B
 			SET_BIT(_regs->B, 0);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 0, B");
-#endif
 			break;
 		case 0xC1:
 			// SET 0, C
 			SET_BIT(_regs->C, 0);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 0, C");
-#endif
 			break;
 		case 0xC2:
 			// SET 0, D
 			SET_BIT(_regs->D, 0);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 0, D");
-#endif
 			break;
 		case 0xC3:
 			// SET 0, E
 			SET_BIT(_regs->E, 0);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 0, E");
-#endif
 			break;
 		case 0xC4:
 			// SET 0, H
 			SET_BIT(_regs->H, 0);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 0, H");
-#endif
 			break;
 		case 0xC5:
 			// SET 0, L
 			SET_BIT(_regs->L, 0);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 0, L");
-#endif
 			break;
 		case 0xC6:
 			// SET 0, (HL)
@@ -3115,65 +2387,41 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			SET_BIT(tmp_c, 0);
 			memory_write8(_regs->HL, tmp_c);
 			cycles = 16;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 0, (HL)");
-#endif
 			break;
 		case 0xC7:
 			// SET 0, A
 			SET_BIT(_regs->A, 0);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 0, A");
-#endif
 			break;
 		case 0xC8:
 			// SET 1, B
 			SET_BIT(_regs->B, 1);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 1, B");
-#endif
 			break;
 		case 0xC9:
 			// SET 1, C
 			SET_BIT(_regs->C, 1);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 1, C");
-#endif
 			break;
 		case 0xCA:
 			// SET 1, D
 			SET_BIT(_regs->D, 1);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 1, D");
-#endif
 			break;
 		case 0xCB:
 			// SET 1, E
 			SET_BIT(_regs->E, 1);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 1, E");
-#endif
 			break;
 		case 0xCC:
 			// SET 1, H
 			SET_BIT(_regs->H, 1);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 1, H");
-#endif
 			break;
 		case 0xCD:
 			// SET 1, L
 			SET_BIT(_regs->L, 1);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 1, L");
-#endif
 			break;
 		case 0xCE:
 			// SET 1, (HL)
@@ -3181,66 +2429,42 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			SET_BIT(tmp_c, 1);
 			memory_write8(_regs->HL, tmp_c);
 			cycles = 16;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 1, (HL)");
-#endif
 			break;
 		case 0xCF:
 			// SET 1, A
 			SET_BIT(_regs->A, 1);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 1, A");
-#endif
 			break;
 
 		case 0xD0:
 			// SET 2, B
 			SET_BIT(_regs->B, 2);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 2, B");
-#endif
 			break;
 		case 0xD1:
 			// SET 2, C
 			SET_BIT(_regs->C, 2);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 2, C");
-#endif
 			break;
 		case 0xD2:
 			// SET 2, D
 			SET_BIT(_regs->D, 2);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 2, D");
-#endif
 			break;
 		case 0xD3:
 			// SET 2, E
 			SET_BIT(_regs->E, 2);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 2, E");
-#endif
 			break;
 		case 0xD4:
 			// SET 2, H
 			SET_BIT(_regs->H, 2);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 2, H");
-#endif
 			break;
 		case 0xD5:
 			// SET 2, L
 			SET_BIT(_regs->L, 2);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 2, L");
-#endif
 			break;
 		case 0xD6:
 			// SET 2, (HL)
@@ -3248,65 +2472,41 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			SET_BIT(tmp_c, 2);
 			memory_write8(_regs->HL, tmp_c);
 			cycles = 16;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 2, (HL)");
-#endif
 			break;
 		case 0xD7:
 			// SET 2, A
 			SET_BIT(_regs->A, 2);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 2, A");
-#endif
 			break;
 		case 0xD8:
 			// SET 3, B
 			SET_BIT(_regs->B, 3);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 3, B");
-#endif
 			break;
 		case 0xD9:
 			// SET 3, C
 			SET_BIT(_regs->C, 3);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 3, C");
-#endif
 			break;
 		case 0xDA:
 			// SET 3, D
 			SET_BIT(_regs->D, 3);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 3, D");
-#endif
 			break;
 		case 0xDB:
 			// SET 3, E
 			SET_BIT(_regs->E, 3);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 3, E");
-#endif
 			break;
 		case 0xDC:
 			// SET 3, H
 			SET_BIT(_regs->H, 3);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 3, H");
-#endif
 			break;
 		case 0xDD:
 			// SET 3, L
 			SET_BIT(_regs->L, 3);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 3, L");
-#endif
 			break;
 		case 0xDE:
 			// SET 3, (HL)
@@ -3314,66 +2514,42 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			SET_BIT(tmp_c, 3);
 			memory_write8(_regs->HL, tmp_c);
 			cycles = 16;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 3, (HL)");
-#endif
 			break;
 		case 0xDF:
 			// SET 3, A
 			SET_BIT(_regs->A, 3);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 3, A");
-#endif
 			break;
 
 		case 0xE0:
 			// SET 4, B
 			SET_BIT(_regs->B, 4);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 6, 4");
-#endif
 			break;
 		case 0xE1:
 			// SET 4, C
 			SET_BIT(_regs->C, 4);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 4, C");
-#endif
 			break;
 		case 0xE2:
 			// SET 4, D
 			SET_BIT(_regs->D, 4);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 4, D");
-#endif
 			break;
 		case 0xE3:
 			// SET 4, E
 			SET_BIT(_regs->E, 4);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 4, E");
-#endif
 			break;
 		case 0xE4:
 			// SET 4, H
 			SET_BIT(_regs->H, 4);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 4, H");
-#endif
 			break;
 		case 0xE5:
 			// SET 4, L
 			SET_BIT(_regs->L, 4);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 4, L");
-#endif
 			break;
 		case 0xE6:
 			// SET 4, (HL)
@@ -3381,65 +2557,41 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			SET_BIT(tmp_c, 4);
 			memory_write8(_regs->HL, tmp_c);
 			cycles = 16;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 4, (HL)");
-#endif
 			break;
 		case 0xE7:
 			// SET 4, A
 			SET_BIT(_regs->A, 4);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 4, A");
-#endif
 			break;
 		case 0xE8:
 			// SET 5, B
 			SET_BIT(_regs->B, 5);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 5, B");
-#endif
 			break;
 		case 0xE9:
 			// SET 5, C
 			SET_BIT(_regs->C, 5);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 5, C");
-#endif
 			break;
 		case 0xEA:
 			// SET 5, D
 			SET_BIT(_regs->D, 5);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 5, D");
-#endif
 			break;
 		case 0xEB:
 			// SET 5, E
 			SET_BIT(_regs->E, 5);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 5, E");
-#endif
 			break;
 		case 0xEC:
 			// SET 5, H
 			SET_BIT(_regs->H, 5);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 5, H");
-#endif
 			break;
 		case 0xED:
 			// SET 5, L
 			SET_BIT(_regs->L, 5);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 5, L");
-#endif
 			break;
 		case 0xEE:
 			// SET 5, (HL)
@@ -3447,66 +2599,42 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			SET_BIT(tmp_c, 5);
 			memory_write8(_regs->HL, tmp_c);
 			cycles = 16;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 5, (HL)");
-#endif
 			break;
 		case 0xEF:
 			// SET 5, A
 			SET_BIT(_regs->A, 5);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 5, A");
-#endif
 			break;
 
 		case 0xF0:
 			// SET 6, B
 			SET_BIT(_regs->B, 6);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 6, B");
-#endif
 			break;
 		case 0xF1:
 			// SET 6, C
 			SET_BIT(_regs->C, 6);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 6, C");
-#endif
 			break;
 		case 0xF2:
 			// SET 6, D
 			SET_BIT(_regs->D, 6);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 6, D");
-#endif
 			break;
 		case 0xF3:
 			// SET 6, E
 			SET_BIT(_regs->E, 6);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 6, E");
-#endif
 			break;
 		case 0xF4:
 			// SET 6, H
 			SET_BIT(_regs->H, 6);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 6, H");
-#endif
 			break;
 		case 0xF5:
 			// SET 6, L
 			SET_BIT(_regs->L, 6);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 6, L");
-#endif
 			break;
 		case 0xF6:
 			// SET 6, (HL)
@@ -3514,65 +2642,41 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			SET_BIT(tmp_c, 6);
 			memory_write8(_regs->HL, tmp_c);
 			cycles = 16;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 6, (HL)");
-#endif
 			break;
 		case 0xF7:
 			// SET 6, A
 			SET_BIT(_regs->A, 6);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 6, A");
-#endif
 			break;
 		case 0xF8:
 			// SET 7, B
 			SET_BIT(_regs->B, 7);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 7, B");
-#endif
 			break;
 		case 0xF9:
 			// SET 7, C
 			SET_BIT(_regs->C, 7);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 7, C");
-#endif
 			break;
 		case 0xFA:
 			// SET 7, D
 			SET_BIT(_regs->D, 7);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 7, D");
-#endif
 			break;
 		case 0xFB:
 			// SET 7, E
 			SET_BIT(_regs->E, 7);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 7, E");
-#endif
 			break;
 		case 0xFC:
 			// SET 7, H
 			SET_BIT(_regs->H, 7);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 7, H");
-#endif
 			break;
 		case 0xFD:
 			// SET 7, L
 			SET_BIT(_regs->L, 7);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 7, L");
-#endif
 			break;
 		case 0xFE:
 			// SET 7, (HL)
@@ -3580,23 +2684,14 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 			SET_BIT(tmp_c, 7);
 			memory_write8(_regs->HL, tmp_c);
 			cycles = 16;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 7, (HL)");
-#endif
 			break;
 		case 0xFF:
 			// SET 7, A
 			SET_BIT(_regs->A, 7);
 			cycles = 8;
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "SET 7, A");
-#endif
 			break;
 
 		default:
-#ifdef DISASSEMBLE
-			sprintf(disassembly, "Unimplemented: 0xCB 0x%02x", opcode);
-#endif
 			_regs->PC -= 2;
 			cycles = 0;
 	}
@@ -3604,10 +2699,34 @@ static unsigned char parse_prefixed_opcode(unsigned char opcode) {
 	return cycles;
 }
 
+/**
+	Append the instruction about to run to the execution trace
+*/
+static void trace_instruction(struct registers * _regs) {
+	struct trace_record * record;
+	unsigned char * memory;
+	
+	memory = memory_dump();
+	record = trace_next();
+	
+	record->cycles = cpu_state.total_cycles;
+	record->pc = _regs->PC;
+	record->sp = _regs->SP;
+	record->af = _regs->AF;
+	record->bc = _regs->BC;
+	record->de = _regs->DE;
+	record->hl = _regs->HL;
+	record->flag = _regs->FLAG;
+	for(int i = 0; i < 3; i++)
+		record->opcode[i] = memory[(_regs->PC + i) % INTERNAL_MEMORY_SIZE];
+	
+	trace_commit();
+}
+
 /**
 	This is odd logic, so abstracted incase needed to change
 */
-static void do_cp(unsigned char val) {
+static void do_cp(struct registers * _regs, unsigned char val) {
 	/**
 	Z - Set if result is zero. (Set if A = n.)
 	N - Set.
@@ -3630,3 +2749,238 @@ static void do_cp(unsigned char val) {
 	else if(!val)
 		_regs->FLAG |= (1 << Z_FLAG);
 }
+
+/**
+	Recognize common copy and fill loops and perform them in bulk
+	
+	PC is the loop head and the loop has the form:
+		[LD A, (DE) | LD A, (HL+) | LD A, n | XOR A | LD A, r]
+		LD (HL+), A | LD (HL-), A | LD (DE), A
+		[INC DE]
+		DEC r | DEC rr, LD A, hi, OR lo
+		JR NZ, head
+	
+	All iterations but the last are collapsed, so the interpreter
+	still runs the exit iteration and produces the final flags.
+	Returns the cycles the collapsed iterations took, which must
+	mirror the cycle counts in parse_opcode, and adds their
+	instructions to instructions (and the opcode histogram).
+*/
+#define LOOP_REG_B  0x01
+#define LOOP_REG_C  0x02
+#define LOOP_REG_D  0x04
+#define LOOP_REG_E  0x08
+#define LOOP_REG_H  0x10
+#define LOOP_REG_L  0x20
+#define LOOP_REG_BC (LOOP_REG_B | LOOP_REG_C)
+#define LOOP_REG_DE (LOOP_REG_D | LOOP_REG_E)
+#define LOOP_REG_HL (LOOP_REG_H | LOOP_REG_L)
+// One instruction of the loop body, for the cycles and instruction counts
+#ifdef PROFILE_OPCODES
+#define LOOP_OPCODE(opcode, cycles) \
+	(body[length] = (opcode), body_cycles[length++] = (cycles), iteration_cycles += (cycles))
+#else
+#define LOOP_OPCODE(opcode, cycles) (length++, iteration_cycles += (cycles))
+#endif
+static unsigned int run_loop_idiom(struct registers * _regs, unsigned long * instructions) {
+	unsigned char * memory, * code, * p;
+	unsigned char * regs8[6], * count8;
+	unsigned short * src, * dst, * count16;
+	unsigned char fill, reload, value, used, iteration_cycles;
+	unsigned char length;
+#ifdef PROFILE_OPCODES
+	unsigned char body[8], body_cycles[8];
+#endif
+	unsigned int iterations, budget, dst_base;
+	int dst_step;
+	
+	memory = memory_dump();
+	if(_regs->PC > INTERNAL_MEMORY_SIZE - 16)
+		return 0;
+	code = p = memory + _regs->PC;
+	
+	// B, C, D, E, H, L in opcode order
+	regs8[0] = &_regs->B; regs8[1] = &_regs->C;
+	regs8[2] = &_regs->D; regs8[3] = &_regs->E;
+	regs8[4] = &_regs->H; regs8[5] = &_regs->L;
+	
+	src = NULL;
+	fill = _regs->A;
+	reload = 1;
+	used = 0;
+	iteration_cycles = 0;
+	length = 0;
+	
+	// Reload of A (optional)
+	if(*p == 0x1A) {
+		// LD A, (DE)
+		src = &_regs->DE;
+		used = LOOP_REG_DE;
+		LOOP_OPCODE(*p, 8);
+		p++;
+	} else if(*p == 0x2A) {
+		// LD A, (HL+)
+		src = &_regs->HL;
+		used = LOOP_REG_HL;
+		LOOP_OPCODE(*p, 8);
+		p++;
+	} else if(*p == 0x3E) {
+		// LD A, n
+		fill = p[1];
+		LOOP_OPCODE(*p, 8);
+		p += 2;
+	} else if(*p == 0xAF) {
+		// XOR A
+		fill = 0;
+		LOOP_OPCODE(*p, 4);
+		p++;
+	} else if(*p >= 0x78 && *p <= 0x7D) {
+		// LD A, r
+		fill = *regs8[*p - 0x78];
+		used = 1 << (*p - 0x78);
+		LOOP_OPCODE(*p, 4);
+		p++;
+	} else {
+		reload = 0;
+	}
+	
+	// Store of A
+	if(*p == 0x22 || *p == 0x32) {
+		// LD (HL+), A / LD (HL-), A
+		if(used & LOOP_REG_HL)
+			return 0;
+		dst = &_regs->HL;
+		dst_step = (*p == 0x22) ? 1 : -1;
+		used |= LOOP_REG_HL;
+	} else if(*p == 0x12) {
+		// LD (DE), A
+		if(used & LOOP_REG_DE)
+			return 0;
+		dst = &_regs->DE;
+		dst_step = 1;
+		used |= LOOP_REG_DE;
+	} else {
+		return 0;
+	}
+	LOOP_OPCODE(*p, 8);
+	p++;
+	
+	// Copies only run forward, backwards fills are fine
+	if(src && dst_step < 0)
+		return 0;
+	
+	// INC DE is required exactly when DE is a pointer
+	if(src == &_regs->DE || dst == &_regs->DE) {
+		if(*p != 0x13)
+			return 0;
+		LOOP_OPCODE(*p, 8);
+		p++;
+	}
+	
+	// The counter may not touch the pointers or the fill register
+	count8 = NULL;
+	count16 = NULL;
+	if(*p == 0x05 || *p == 0x0D || *p == 0x15 || *p == 0x1D) {
+		// DEC r
+		if(used & (1 << (*p >> 3)))
+			return 0;
+		count8 = regs8[*p >> 3];
+		iterations = *count8 ? *count8 : 0x100;
+		LOOP_OPCODE(*p, 4);
+		p++;
+	} else if(p[0] == 0x0B && p[1] == 0x78 && p[2] == 0xB1) {
+		// DEC BC, LD A, B, OR C
+		if(used & LOOP_REG_BC)
+			return 0;
+		count16 = &_regs->BC;
+		LOOP_OPCODE(p[0], 8);
+		LOOP_OPCODE(p[1], 4);
+		LOOP_OPCODE(p[2], 4);
+		p += 3;
+	} else if(p[0] == 0x1B && p[1] == 0x7A && p[2] == 0xB3) {
+		// DEC DE, LD A, D, OR E
+		if(used & LOOP_REG_DE)
+			return 0;
+		count16 = &_regs->DE;
+		LOOP_OPCODE(p[0], 8);
+		LOOP_OPCODE(p[1], 4);
+		LOOP_OPCODE(p[2], 4);
+		p += 3;
+	} else {
+		return 0;
+	}
+	
+	if(count16) {
+		// A is clobbered by the counter test, so it must be reloaded
+		if(!reload)
+			return 0;
+		iterations = *count16 ? *count16 : 0x10000;
+	}
+	
+	// JR NZ back to the loop head
+	if(p[0] != 0x20 || (p - code) + 2 + (signed char)p[1] != 0)
+		return 0;
+	LOOP_OPCODE(p[0], 8);
+	p += 2;
+	
+	// The bootstrap is swapped out when reaching $0100
+	if(_regs->PC <= 0x100 && _regs->PC + (p - code) > 0x100)
+		return 0;
+	
+	// Leave the exit iteration to the interpreter and stay
+	// clear of anything the LCD would do in the meantime
+	iterations--;
+	budget = lcd_idleCycles() / iteration_cycles;
+	if(iterations > budget)
+		iterations = budget;
+	if(iterations < 2)
+		return 0;
+	
+	// Only plain memory, no overlap with the source or the loop itself
+	dst_base = (dst_step > 0) ? *dst : *dst - (iterations - 1);
+	if(dst_step < 0 && *dst < iterations - 1)
+		return 0;
+	if(!memory_isPlain(dst_base, iterations, MEMORY_WRITE))
+		return 0;
+	if(dst_base < _regs->PC + (p - code) && dst_base + iterations > _regs->PC)
+		return 0;
+	if(src) {
+		if(!memory_isPlain(*src, iterations, MEMORY_READ))
+			return 0;
+		if(dst_base < *src + iterations && dst_base + iterations > *src)
+			return 0;
+	}
+	
+	// Do the work
+	if(src) {
+		memory_copy(dst_base, *src, iterations);
+		*src += iterations;
+		fill = memory[*src - 1];
+	} else {
+		memory_fill(dst_base, fill, iterations);
+	}
+	*dst += dst_step * (int)iterations;
+	
+	// Registers as the interpreter leaves them at the loop head
+	if(count8) {
+		*count8 -= iterations;
+		value = *count8;
+		_regs->FLAG = FLAG_COMPUTE_DEC(value);
+		_regs->A = fill;
+	} else {
+		*count16 -= iterations;
+		_regs->A = (*count16 >> 8) | (*count16 & 0xFF);
+		_regs->FLAG = 0;
+	}
+	
+	// Count the collapsed instructions as if they had run
+	*instructions += iterations * length;
+#ifdef PROFILE_OPCODES
+	for(int i = 0; i < length; i++) {
+		profiler_opcodes[body[i]].count += iterations;
+		profiler_opcodes[body[i]].cycles += iterations * body_cycles[i];
+	}
+#endif
+	
+	return iterations * iteration_cycles;
+}
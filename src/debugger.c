@@ -3,6 +3,9 @@
 #include "debugger.h"
 #include "cpu.h"
 #include "memory.h"
+#include "disasm.h"
+#include "graphics.h"
+#include "joypad.h"
 
 /**
 Static Variables
@@ -36,6 +39,7 @@ void debugger_loop() {
 	
 	char * line;
 	size_t line_size;
+	char text[DISASM_MAX_LENGTH];
 	
 	line_size = 32;
 	line = malloc(line_size);
@@ -124,10 +128,13 @@ void debugger_loop() {
 			return;
 		}
 		
-#ifdef DISASSEMBLE
 		// Print last instruction executed
-		printf("$%04x: %s\n", disassembly_pc, disassembly);
-#endif
+		disasm(disassembly_pc, text);
+		printf("$%04x: %s\n", disassembly_pc, text);
+		
+		// The window was closed while running
+		if(!cpu_state.running)
+			return;
 	}
 }
 
@@ -142,8 +149,10 @@ static short readNumber(char * line) {
 }
 
 static void debugger_continue() {
+	unsigned long cycles;
 	int i;
 	
+	cycles = 0;
 	while(cpu_state.running && !ctrl_c) {
 		// Determine if we need to break out (breakpoint hit)
 		for(i = 0; i < settings.number_breakpoints; i++) {
@@ -156,7 +165,14 @@ static void debugger_continue() {
 		}
 		
 		// If no breakpoints, continue execution
-		cpu_step();
+		cycles += cpu_step();
+		
+		// Window events and input once per frame, like the main loop
+		if(cycles >= CPU_CYCLES_PER_FRAME) {
+			graphics_pollEvents();
+			joypad_update();
+			cycles = 0;
+		}
 	}
 }
 
@@ -0,0 +1,385 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "disasm.h"
+#include "memory.h"
+
+/**
+Static Variables
+*/
+static const struct disasm_entry opcodes[256] = {
+	/* $00 */ { "NOP",                     1, DISASM_NONE },
+	/* $01 */ { "LD BC, $%04x",            3, DISASM_U16 },
+	/* $02 */ { "LD (BC), A",              1, DISASM_NONE },
+	/* $03 */ { "INC BC",                  1, DISASM_NONE },
+	/* $04 */ { "INC B",                   1, DISASM_NONE },
+	/* $05 */ { "DEC B",                   1, DISASM_NONE },
+	/* $06 */ { "LD B, $%02x",             2, DISASM_U8 },
+	/* $07 */ { "RLCA",                    1, DISASM_NONE },
+	/* $08 */ { "LD ($%04x), SP",          3, DISASM_U16 },
+	/* $09 */ { "ADD HL, BC",              1, DISASM_NONE },
+	/* $0A */ { "LD A, (BC)",              1, DISASM_NONE },
+	/* $0B */ { "DEC BC",                  1, DISASM_NONE },
+	/* $0C */ { "INC C",                   1, DISASM_NONE },
+	/* $0D */ { "DEC C",                   1, DISASM_NONE },
+	/* $0E */ { "LD C, $%02x",             2, DISASM_U8 },
+	/* $0F */ { "RRCA",                    1, DISASM_NONE },
+	/* $10 */ { "STOP",                    2, DISASM_NONE },
+	/* $11 */ { "LD DE, $%04x",            3, DISASM_U16 },
+	/* $12 */ { "LD (DE), A",              1, DISASM_NONE },
+	/* $13 */ { "INC DE",                  1, DISASM_NONE },
+	/* $14 */ { "INC D",                   1, DISASM_NONE },
+	/* $15 */ { "DEC D",                   1, DISASM_NONE },
+	/* $16 */ { "LD D, $%02x",             2, DISASM_U8 },
+	/* $17 */ { "RLA",                     1, DISASM_NONE },
+	/* $18 */ { "JR $%04x",                2, DISASM_REL8 },
+	/* $19 */ { "ADD HL, DE",              1, DISASM_NONE },
+	/* $1A */ { "LD A, (DE)",              1, DISASM_NONE },
+	/* $1B */ { "DEC DE",                  1, DISASM_NONE },
+	/* $1C */ { "INC E",                   1, DISASM_NONE },
+	/* $1D */ { "DEC E",                   1, DISASM_NONE },
+	/* $1E */ { "LD E, $%02x",             2, DISASM_U8 },
+	/* $1F */ { "RRA",                     1, DISASM_NONE },
+	/* $20 */ { "JR NZ, $%04x",            2, DISASM_REL8 },
+	/* $21 */ { "LD HL, $%04x",            3, DISASM_U16 },
+	/* $22 */ { "LD (HL+), A",             1, DISASM_NONE },
+	/* $23 */ { "INC HL",                  1, DISASM_NONE },
+	/* $24 */ { "INC H",                   1, DISASM_NONE },
+	/* $25 */ { "DEC H",                   1, DISASM_NONE },
+	/* $26 */ { "LD H, $%02x",             2, DISASM_U8 },
+	/* $27 */ { "DAA",                     1, DISASM_NONE },
+	/* $28 */ { "JR Z, $%04x",             2, DISASM_REL8 },
+	/* $29 */ { "ADD HL, HL",              1, DISASM_NONE },
+	/* $2A */ { "LD A, (HL+)",             1, DISASM_NONE },
+	/* $2B */ { "DEC HL",                  1, DISASM_NONE },
+	/* $2C */ { "INC L",                   1, DISASM_NONE },
+	/* $2D */ { "DEC L",                   1, DISASM_NONE },
+	/* $2E */ { "LD L, $%02x",             2, DISASM_U8 },
+	/* $2F */ { "CPL",                     1, DISASM_NONE },
+	/* $30 */ { "JR NC, $%04x",            2, DISASM_REL8 },
+	/* $31 */ { "LD SP, $%04x",            3, DISASM_U16 },
+	/* $32 */ { "LD (HL-), A",             1, DISASM_NONE },
+	/* $33 */ { "INC SP",                  1, DISASM_NONE },
+	/* $34 */ { "INC (HL)",                1, DISASM_NONE },
+	/* $35 */ { "DEC (HL)",                1, DISASM_NONE },
+	/* $36 */ { "LD (HL), $%02x",          2, DISASM_U8 },
+	/* $37 */ { "SCF",                     1, DISASM_NONE },
+	/* $38 */ { "JR C, $%04x",             2, DISASM_REL8 },
+	/* $39 */ { "ADD HL, SP",              1, DISASM_NONE },
+	/* $3A */ { "LD A, (HL-)",             1, DISASM_NONE },
+	/* $3B */ { "DEC SP",                  1, DISASM_NONE },
+	/* $3C */ { "INC A",                   1, DISASM_NONE },
+	/* $3D */ { "DEC A",                   1, DISASM_NONE },
+	/* $3E */ { "LD A, $%02x",             2, DISASM_U8 },
+	/* $3F */ { "CCF",                     1, DISASM_NONE },
+	/* $40 */ { "LD B, B",                 1, DISASM_NONE },
+	/* $41 */ { "LD B, C",                 1, DISASM_NONE },
+	/* $42 */ { "LD B, D",                 1, DISASM_NONE },
+	/* $43 */ { "LD B, E",                 1, DISASM_NONE },
+	/* $44 */ { "LD B, H",                 1, DISASM_NONE },
+	/* $45 */ { "LD B, L",                 1, DISASM_NONE },
+	/* $46 */ { "LD B, (HL)",              1, DISASM_NONE },
+	/* $47 */ { "LD B, A",                 1, DISASM_NONE },
+	/* $48 */ { "LD C, B",                 1, DISASM_NONE },
+	/* $49 */ { "LD C, C",                 1, DISASM_NONE },
+	/* $4A */ { "LD C, D",                 1, DISASM_NONE },
+	/* $4B */ { "LD C, E",                 1, DISASM_NONE },
+	/* $4C */ { "LD C, H",                 1, DISASM_NONE },
+	/* $4D */ { "LD C, L",                 1, DISASM_NONE },
+	/* $4E */ { "LD C, (HL)",              1, DISASM_NONE },
+	/* $4F */ { "LD C, A",                 1, DISASM_NONE },
+	/* $50 */ { "LD D, B",                 1, DISASM_NONE },
+	/* $51 */ { "LD D, C",                 1, DISASM_NONE },
+	/* $52 */ { "LD D, D",                 1, DISASM_NONE },
+	/* $53 */ { "LD D, E",                 1, DISASM_NONE },
+	/* $54 */ { "LD D, H",                 1, DISASM_NONE },
+	/* $55 */ { "LD D, L",                 1, DISASM_NONE },
+	/* $56 */ { "LD D, (HL)",              1, DISASM_NONE },
+	/* $57 */ { "LD D, A",                 1, DISASM_NONE },
+	/* $58 */ { "LD E, B",                 1, DISASM_NONE },
+	/* $59 */ { "LD E, C",                 1, DISASM_NONE },
+	/* $5A */ { "LD E, D",                 1, DISASM_NONE },
+	/* $5B */ { "LD E, E",                 1, DISASM_NONE },
+	/* $5C */ { "LD E, H",                 1, DISASM_NONE },
+	/* $5D */ { "LD E, L",                 1, DISASM_NONE },
+	/* $5E */ { "LD E, (HL)",              1, DISASM_NONE },
+	/* $5F */ { "LD E, A",                 1, DISASM_NONE },
+	/* $60 */ { "LD H, B",                 1, DISASM_NONE },
+	/* $61 */ { "LD H, C",                 1, DISASM_NONE },
+	/* $62 */ { "LD H, D",                 1, DISASM_NONE },
+	/* $63 */ { "LD H, E",                 1, DISASM_NONE },
+	/* $64 */ { "LD H, H",                 1, DISASM_NONE },
+	/* $65 */ { "LD H, L",                 1, DISASM_NONE },
+	/* $66 */ { "LD H, (HL)",              1, DISASM_NONE },
+	/* $67 */ { "LD H, A",                 1, DISASM_NONE },
+	/* $68 */ { "LD L, B",                 1, DISASM_NONE },
+	/* $69 */ { "LD L, C",                 1, DISASM_NONE },
+	/* $6A */ { "LD L, D",                 1, DISASM_NONE },
+	/* $6B */ { "LD L, E",                 1, DISASM_NONE },
+	/* $6C */ { "LD L, H",                 1, DISASM_NONE },
+	/* $6D */ { "LD L, L",                 1, DISASM_NONE },
+	/* $6E */ { "LD L, (HL)",              1, DISASM_NONE },
+	/* $6F */ { "LD L, A",                 1, DISASM_NONE },
+	/* $70 */ { "LD (HL), B",              1, DISASM_NONE },
+	/* $71 */ { "LD (HL), C",              1, DISASM_NONE },
+	/* $72 */ { "LD (HL), D",              1, DISASM_NONE },
+	/* $73 */ { "LD (HL), E",              1, DISASM_NONE },
+	/* $74 */ { "LD (HL), H",              1, DISASM_NONE },
+	/* $75 */ { "LD (HL), L",              1, DISASM_NONE },
+	/* $76 */ { "HALT",                    1, DISASM_NONE },
+	/* $77 */ { "LD (HL), A",              1, DISASM_NONE },
+	/* $78 */ { "LD A, B",                 1, DISASM_NONE },
+	/* $79 */ { "LD A, C",                 1, DISASM_NONE },
+	/* $7A */ { "LD A, D",                 1, DISASM_NONE },
+	/* $7B */ { "LD A, E",                 1, DISASM_NONE },
+	/* $7C */ { "LD A, H",                 1, DISASM_NONE },
+	/* $7D */ { "LD A, L",                 1, DISASM_NONE },
+	/* $7E */ { "LD A, (HL)",              1, DISASM_NONE },
+	/* $7F */ { "LD A, A",                 1, DISASM_NONE },
+	/* $80 */ { "ADD A, B",                1, DISASM_NONE },
+	/* $81 */ { "ADD A, C",                1, DISASM_NONE },
+	/* $82 */ { "ADD A, D",                1, DISASM_NONE },
+	/* $83 */ { "ADD A, E",                1, DISASM_NONE },
+	/* $84 */ { "ADD A, H",                1, DISASM_NONE },
+	/* $85 */ { "ADD A, L",                1, DISASM_NONE },
+	/* $86 */ { "ADD A, (HL)",             1, DISASM_NONE },
+	/* $87 */ { "ADD A, A",                1, DISASM_NONE },
+	/* $88 */ { "ADC A, B",                1, DISASM_NONE },
+	/* $89 */ { "ADC A, C",                1, DISASM_NONE },
+	/* $8A */ { "ADC A, D",                1, DISASM_NONE },
+	/* $8B */ { "ADC A, E",                1, DISASM_NONE },
+	/* $8C */ { "ADC A, H",                1, DISASM_NONE },
+	/* $8D */ { "ADC A, L",                1, DISASM_NONE },
+	/* $8E */ { "ADC A, (HL)",             1, DISASM_NONE },
+	/* $8F */ { "ADC A, A",                1, DISASM_NONE },
+	/* $90 */ { "SUB B",                   1, DISASM_NONE },
+	/* $91 */ { "SUB C",                   1, DISASM_NONE },
+	/* $92 */ { "SUB D",                   1, DISASM_NONE },
+	/* $93 */ { "SUB E",                   1, DISASM_NONE },
+	/* $94 */ { "SUB H",                   1, DISASM_NONE },
+	/* $95 */ { "SUB L",                   1, DISASM_NONE },
+	/* $96 */ { "SUB (HL)",                1, DISASM_NONE },
+	/* $97 */ { "SUB A",                   1, DISASM_NONE },
+	/* $98 */ { "SBC A, B",                1, DISASM_NONE },
+	/* $99 */ { "SBC A, C",                1, DISASM_NONE },
+	/* $9A */ { "SBC A, D",                1, DISASM_NONE },
+	/* $9B */ { "SBC A, E",                1, DISASM_NONE },
+	/* $9C */ { "SBC A, H",                1, DISASM_NONE },
+	/* $9D */ { "SBC A, L",                1, DISASM_NONE },
+	/* $9E */ { "SBC A, (HL)",             1, DISASM_NONE },
+	/* $9F */ { "SBC A, A",                1, DISASM_NONE },
+	/* $A0 */ { "AND B",                   1, DISASM_NONE },
+	/* $A1 */ { "AND C",                   1, DISASM_NONE },
+	/* $A2 */ { "AND D",                   1, DISASM_NONE },
+	/* $A3 */ { "AND E",                   1, DISASM_NONE },
+	/* $A4 */ { "AND H",                   1, DISASM_NONE },
+	/* $A5 */ { "AND L",                   1, DISASM_NONE },
+	/* $A6 */ { "AND (HL)",                1, DISASM_NONE },
+	/* $A7 */ { "AND A",                   1, DISASM_NONE },
+	/* $A8 */ { "XOR B",                   1, DISASM_NONE },
+	/* $A9 */ { "XOR C",                   1, DISASM_NONE },
+	/* $AA */ { "XOR D",                   1, DISASM_NONE },
+	/* $AB */ { "XOR E",                   1, DISASM_NONE },
+	/* $AC */ { "XOR H",                   1, DISASM_NONE },
+	/* $AD */ { "XOR L",                   1, DISASM_NONE },
+	/* $AE */ { "XOR (HL)",                1, DISASM_NONE },
+	/* $AF */ { "XOR A",                   1, DISASM_NONE },
+	/* $B0 */ { "OR B",                    1, DISASM_NONE },
+	/* $B1 */ { "OR C",                    1, DISASM_NONE },
+	/* $B2 */ { "OR D",                    1, DISASM_NONE },
+	/* $B3 */ { "OR E",                    1, DISASM_NONE },
+	/* $B4 */ { "OR H",                    1, DISASM_NONE },
+	/* $B5 */ { "OR L",                    1, DISASM_NONE },
+	/* $B6 */ { "OR (HL)",                 1, DISASM_NONE },
+	/* $B7 */ { "OR A",                    1, DISASM_NONE },
+	/* $B8 */ { "CP B",                    1, DISASM_NONE },
+	/* $B9 */ { "CP C",                    1, DISASM_NONE },
+	/* $BA */ { "CP D",                    1, DISASM_NONE },
+	/* $BB */ { "CP E",                    1, DISASM_NONE },
+	/* $BC */ { "CP H",                    1, DISASM_NONE },
+	/* $BD */ { "CP L",                    1, DISASM_NONE },
+	/* $BE */ { "CP (HL)",                 1, DISASM_NONE },
+	/* $BF */ { "CP A",                    1, DISASM_NONE },
+	/* $C0 */ { "RET NZ",                  1, DISASM_NONE },
+	/* $C1 */ { "POP BC",                  1, DISASM_NONE },
+	/* $C2 */ { "JP NZ, $%04x",            3, DISASM_U16 },
+	/* $C3 */ { "JP $%04x",                3, DISASM_U16 },
+	/* $C4 */ { "CALL NZ, $%04x",          3, DISASM_U16 },
+	/* $C5 */ { "PUSH BC",                 1, DISASM_NONE },
+	/* $C6 */ { "ADD A, $%02x",            2, DISASM_U8 },
+	/* $C7 */ { "RST $00",                 1, DISASM_NONE },
+	/* $C8 */ { "RET Z",                   1, DISASM_NONE },
+	/* $C9 */ { "RET",                     1, DISASM_NONE },
+	/* $CA */ { "JP Z, $%04x",             3, DISASM_U16 },
+	/* $CB */ { "PREFIX CB",               2, DISASM_NONE },
+	/* $CC */ { "CALL Z, $%04x",           3, DISASM_U16 },
+	/* $CD */ { "CALL $%04x",              3, DISASM_U16 },
+	/* $CE */ { "ADC A, $%02x",            2, DISASM_U8 },
+	/* $CF */ { "RST $08",                 1, DISASM_NONE },
+	/* $D0 */ { "RET NC",                  1, DISASM_NONE },
+	/* $D1 */ { "POP DE",                  1, DISASM_NONE },
+	/* $D2 */ { "JP NC, $%04x",            3, DISASM_U16 },
+	/* $D3 */ { "DB $%02x",                1, DISASM_OPCODE },
+	/* $D4 */ { "CALL NC, $%04x",          3, DISASM_U16 },
+	/* $D5 */ { "PUSH DE",                 1, DISASM_NONE },
+	/* $D6 */ { "SUB $%02x",               2, DISASM_U8 },
+	/* $D7 */ { "RST $10",                 1, DISASM_NONE },
+	/* $D8 */ { "RET C",                   1, DISASM_NONE },
+	/* $D9 */ { "RETI",                    1, DISASM_NONE },
+	/* $DA */ { "JP C, $%04x",             3, DISASM_U16 },
+	/* $DB */ { "DB $%02x",                1, DISASM_OPCODE },
+	/* $DC */ { "CALL C, $%04x",           3, DISASM_U16 },
+	/* $DD */ { "DB $%02x",                1, DISASM_OPCODE },
+	/* $DE */ { "SBC A, $%02x",            2, DISASM_U8 },
+	/* $DF */ { "RST $18",                 1, DISASM_NONE },
+	/* $E0 */ { "LD ($FF00 + $%02x), A",   2, DISASM_U8 },
+	/* $E1 */ { "POP HL",                  1, DISASM_NONE },
+	/* $E2 */ { "LD ($FF00 + C), A",       1, DISASM_NONE },
+	/* $E3 */ { "DB $%02x",                1, DISASM_OPCODE },
+	/* $E4 */ { "DB $%02x",                1, DISASM_OPCODE },
+	/* $E5 */ { "PUSH HL",                 1, DISASM_NONE },
+	/* $E6 */ { "AND $%02x",               2, DISASM_U8 },
+	/* $E7 */ { "RST $20",                 1, DISASM_NONE },
+	/* $E8 */ { "ADD SP, %d",              2, DISASM_S8 },
+	/* $E9 */ { "JP (HL)",                 1, DISASM_NONE },
+	/* $EA */ { "LD ($%04x), A",           3, DISASM_U16 },
+	/* $EB */ { "DB $%02x",                1, DISASM_OPCODE },
+	/* $EC */ { "DB $%02x",                1, DISASM_OPCODE },
+	/* $ED */ { "DB $%02x",                1, DISASM_OPCODE },
+	/* $EE */ { "XOR $%02x",               2, DISASM_U8 },
+	/* $EF */ { "RST $28",                 1, DISASM_NONE },
+	/* $F0 */ { "LD A, ($FF00 + $%02x)",   2, DISASM_U8 },
+	/* $F1 */ { "POP AF",                  1, DISASM_NONE },
+	/* $F2 */ { "LD A, ($FF00 + C)",       1, DISASM_NONE },
+	/* $F3 */ { "DI",                      1, DISASM_NONE },
+	/* $F4 */ { "DB $%02x",                1, DISASM_OPCODE },
+	/* $F5 */ { "PUSH AF",                 1, DISASM_NONE },
+	/* $F6 */ { "OR $%02x",                2, DISASM_U8 },
+	/* $F7 */ { "RST $30",                 1, DISASM_NONE },
+	/* $F8 */ { "LD HL, SP + %d",          2, DISASM_S8 },
+	/* $F9 */ { "LD SP, HL",               1, DISASM_NONE },
+	/* $FA */ { "LD A, ($%04x)",           3, DISASM_U16 },
+	/* $FB */ { "EI",                      1, DISASM_NONE },
+	/* $FC */ { "DB $%02x",                1, DISASM_OPCODE },
+	/* $FD */ { "DB $%02x",                1, DISASM_OPCODE },
+	/* $FE */ { "CP $%02x",                2, DISASM_U8 },
+	/* $FF */ { "RST $38",                 1, DISASM_NONE },
+};
+
+/**
+CB prefixed opcodes are regular enough to build from their fields
+	xx ooo rrr
+	00 - Rotates/shifts (ooo picks the operation)
+	01 - BIT ooo, r
+	10 - RES ooo, r
+	11 - SET ooo, r
+*/
+static const char * prefixed_shifts[8] = {
+	"RLC", "RRC", "RL", "RR", "SLA", "SRA", "SWAP", "SRL"
+};
+static const char * prefixed_bits[4] = {
+	NULL, "BIT", "RES", "SET"
+};
+static const char * prefixed_registers[8] = {
+	"B", "C", "D", "E", "H", "L", "(HL)", "A"
+};
+
+/**
+Functions
+*/
+/**
+	Disassemble the instruction in bytes (at least 3 long) as if it
+	was located at addr. Returns the length of the instruction.
+*/
+int disasm_bytes(unsigned short addr, const unsigned char * bytes, char * buf) {
+	const struct disasm_entry * entry;
+	unsigned char group;
+	
+	if(bytes[0] == 0xCB) {
+		group = bytes[1] >> 6;
+		if(group) {
+			sprintf(buf, "%s %d, %s",
+				prefixed_bits[group],
+				(bytes[1] >> 3) & 0x7,
+				prefixed_registers[bytes[1] & 0x7]
+			);
+		} else {
+			sprintf(buf, "%s %s",
+				prefixed_shifts[(bytes[1] >> 3) & 0x7],
+				prefixed_registers[bytes[1] & 0x7]
+			);
+		}
+		return 2;
+	}
+	
+	entry = &opcodes[bytes[0]];
+	switch(entry->operand) {
+		case DISASM_NONE:
+			sprintf(buf, "%s", entry->format);
+			break;
+		case DISASM_U8:
+			sprintf(buf, entry->format, bytes[1]);
+			break;
+		case DISASM_U16:
+			sprintf(buf, entry->format, bytes[1] | (bytes[2] << 8));
+			break;
+		case DISASM_S8:
+			sprintf(buf, entry->format, (signed char)bytes[1]);
+			break;
+		case DISASM_REL8:
+			sprintf(buf, entry->format, (unsigned short)(addr + 2 + (signed char)bytes[1]));
+			break;
+		case DISASM_OPCODE:
+			sprintf(buf, entry->format, bytes[0]);
+			break;
+	}
+	
+	return entry->length;
+}
+
+/**
+	Instruction without its operand values, e.g. "LD A, n"
+*/
+void disasm_mnemonic(const unsigned char * bytes, char * buf) {
+	const char * format;
+	
+	if(bytes[0] == 0xCB || opcodes[bytes[0]].operand == DISASM_OPCODE) {
+		disasm_bytes(0, bytes, buf);
+		return;
+	}
+	
+	for(format = opcodes[bytes[0]].format; *format; format++) {
+		if(!strncmp(format, "$%04x", 5) && opcodes[bytes[0]].operand == DISASM_REL8) {
+			*buf++ = 'e';
+			format += 4;
+		} else if(!strncmp(format, "$%04x", 5)) {
+			*buf++ = 'n';
+			*buf++ = 'n';
+			format += 4;
+		} else if(!strncmp(format, "$%02x", 5)) {
+			*buf++ = 'n';
+			format += 4;
+		} else if(!strncmp(format, "%d", 2)) {
+			*buf++ = 'e';
+			format += 1;
+		} else {
+			*buf++ = *format;
+		}
+	}
+	*buf = 0;
+}
+
+#ifndef DISASM_OFFLINE
+/**
+	Disassemble the instruction currently in memory at addr
+*/
+int disasm(unsigned short addr, char * buf) {
+	unsigned char bytes[3];
+	
+	// Raw reads, I/O handlers must not see the disassembler
+	for(int i = 0; i < 3; i++)
+		bytes[i] = ((unsigned char *)memory_dump())[(addr + i) % INTERNAL_MEMORY_SIZE];
+	
+	return disasm_bytes(addr, bytes, buf);
+}
+#endif
@@ -1,3 +1,6 @@
+#include <time.h>
+#include <errno.h>
+
 #include "emulator.h"
 #include "cpu.h"
 #include "memory.h"
@@ -6,6 +9,16 @@
 #include "rom.h"
 #include "interrupt.h"
 #include "debugger.h"
+#include "trace.h"
+#include "profiler.h"
+#include "timeline.h"
+#include "perf.h"
+#include "joypad.h"
+
+/**
+Static Functions
+*/
+static void paceFrame();
 
 /**
 Functions
@@ -50,15 +63,23 @@ int main(int argc, char ** argv) {
 		// Print help
 		if(!strcmp(argv[i], "-h")) {
 			printf("usage: %s\n", argv[0]);
-			printf("\t-f                  ROM File (.gb)\n");
+			printf("\t-f                    ROM File (.gb)\n");
 #ifdef DISASSEMBLE
-			printf("\t-debug              Start debugger\n");
+			printf("\t-debug                Start debugger\n");
 #endif
-			printf("\t-ignore-bootloader  Skip bootloader\n");
-			printf("\t-h                  Display this screen\n");
+			printf("\t-ignore-bootloader    Skip bootloader\n");
+			printf("\t-trace <file>         Record every instruction (see trace_decode)\n");
+			printf("\t-profile <cycles>     Sample the PC every n cycles, report at exit\n");
+			printf("\t-callgraph <file>     Write collapsed call stacks for flame graphs\n");
+			printf("\t-chrome-trace <file>  Write a frame timeline for chrome://tracing\n");
+			printf("\t-perf                 Count host cycles, instructions and misses (Linux)\n");
+			printf("\t-deferred             Render whole frames at VBlank from a register log\n");
+			printf("\t-turbo <n>            Fast forward, draw one frame in n (0 for none), Tab toggles\n");
+			printf("\t-sym <file>           RGBDS symbols for the profiler report\n");
+			printf("\t-h                    Display this screen\n");
 			return 0;
 		}
-
+	
 #ifdef DISASSEMBLE
 		// Start debugger
 		if(!strcmp(argv[i], "-debug")) {
@@ -70,23 +91,97 @@ int main(int argc, char ** argv) {
 		if(!strcmp(argv[i], "-ignore-bootloader")) {
 			cpu_rom_reset();
 		}
+		
+		// Binary execution trace
+		if(!strcmp(argv[i], "-trace") && i+1 < argc) {
+			trace_open(argv[++i]);
+		}
+		
+		// Host timeline
+		if(!strcmp(argv[i], "-chrome-trace") && i+1 < argc) {
+			timeline_open(argv[++i]);
+		}
+		
+		// Hardware counters
+		if(!strcmp(argv[i], "-perf")) {
+			perf_open();
+		}
+		
+		// Frame rendering at VBlank
+		if(!strcmp(argv[i], "-deferred")) {
+			lcd_setDeferred(1);
+		}
+		
+		// Fast forward
+		if(!strcmp(argv[i], "-turbo") && i+1 < argc) {
+			lcd_setTurboInterval(atoi(argv[++i]));
+			lcd_setTurbo(1);
+		}
+		
+		// Sampling profiler
+		if(!strcmp(argv[i], "-profile") && i+1 < argc) {
+			profiler_init(atoi(argv[++i]));
+		}
+		if(!strcmp(argv[i], "-callgraph") && i+1 < argc) {
+			profiler_initCallgraph(argv[++i]);
+		}
+		if(!strcmp(argv[i], "-sym") && i+1 < argc) {
+			profiler_loadSymbols(argv[++i]);
+		}
 	}
 	
 #ifdef DISASSEMBLE
 	if(debugger) {
 		debugger_init();
 		debugger_loop();
-	} else {
-		while(cpu_state.running) {
-			cpu_step();
-			printf("$%04x %s\n", disassembly_pc, disassembly);
-		}
+		cpu_state.running = 0;
 	}
-#else
+#endif
+	perf_start();
 	while(cpu_state.running) {
-		cpu_step();
+		cpu_run(CPU_CYCLES_PER_FRAME);
+		paceFrame();
+		
+		// Window events on the main thread, then into the joypad
+		PHASE_BEGIN(PHASE_EVENTS);
+		graphics_pollEvents();
+		joypad_update();
+		PHASE_END();
 	}
-#endif
-
+	perf_stop();
+	graphics_destroy();
+	
+	trace_close();
+	timeline_close();
+	profiler_report(stdout);
+	perf_report(stdout);
+	joypad_report(stdout);
+	
 	return 0;
 }
+
+/**
+Static Functions
+*/
+/**
+	Sleeps until the next frame is due, presenting no longer holds
+	up this thread. Turbo runs as fast as the host can, a host that
+	fell behind by more than a frame does not try to catch up.
+*/
+static void paceFrame() {
+	static unsigned long long next_frame;
+	struct timespec now, deadline;
+	unsigned long long now_ns;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	now_ns = now.tv_sec * 1000000000ull + now.tv_nsec;
+	next_frame += EMULATOR_FRAME_NS;
+	if(lcd_turbo || next_frame + EMULATOR_FRAME_NS < now_ns) {
+		next_frame = now_ns;
+		return;
+	}
+	
+	deadline.tv_sec = next_frame / 1000000000ull;
+	deadline.tv_nsec = next_frame % 1000000000ull;
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+}
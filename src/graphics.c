@@ -1,86 +1,250 @@
+#include <stdatomic.h>
+#include <string.h>
+
 #include "graphics.h"
 #include "emulator.h"
 #include "cpu.h"
+#include "timeline.h"
+#include "input.h"
+
+/**
+Frames are handed to the render thread through three buffers: the
+emulation thread draws into back, the render thread shows front and
+ready holds the last completed frame. Both sides only ever exchange
+their own buffer with ready, so neither waits for the other.
+*/
+#define GRAPHICS_FRESH 0x4 // Set in ready until the render thread takes it
 
+/**
+Static Functions
+*/
+static int graphics_thread(void * unused);
+static void updateTexture(SDL_Texture * texture, int front, unsigned long long * shown);
+static unsigned short keyButton(SDL_Keycode key);
+static unsigned long long eventTime(const SDL_Event * event);
 static void splashScreen();
 
-static SDL_Renderer * renderer;
+/**
+Global variables
+*/
+unsigned int * graphics_framebuffer;
+unsigned long long * graphics_signatures;
+
+/**
+Static Variables
+*/
+static char headless;
+static unsigned int framebuffers[3][LCD_SCREEN_WIDTH * LCD_SCREEN_HEIGHT];
+static unsigned long long signatures[3][LCD_SCREEN_HEIGHT];
+static int back;
+static atomic_int ready;
+
 static SDL_Window * window;
+static SDL_Thread * render_thread;
+static SDL_sem * frame_posted;
+static atomic_char render_stop;
+
+/**
+	Run without a window, must be set before graphics_init()
+	Nothing is drawn and there are no events to poll
+*/
+void graphics_setHeadless(char enabled) {
+	headless = enabled;
+}
 
-void graphics_init(char * window_title) {	
+void graphics_init(char * window_title) {
+	back = 0;
+	atomic_store(&ready, 1);
+	graphics_framebuffer = framebuffers[back];
+	graphics_signatures = signatures[back];
+	if(headless)
+		return;
+	
+	// The window and its events stay on the main thread, SDL does
+	// not support them anywhere else on every platform
 	SDL_Init(SDL_INIT_VIDEO);
-	SDL_CreateWindowAndRenderer(
+	window = SDL_CreateWindow(window_title,
+		SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
 		LCD_SCREEN_WIDTH * GRAPHICS_SCALE,
 		LCD_SCREEN_HEIGHT * GRAPHICS_SCALE,
-		SDL_WINDOW_SHOWN,
-		&window, &renderer
+		SDL_WINDOW_SHOWN
 	);
-	SDL_SetWindowTitle(window, window_title);
+	
+	// Only uploading and presenting move to the render thread
+	atomic_store(&render_stop, 0);
+	frame_posted = SDL_CreateSemaphore(0);
+	render_thread = SDL_CreateThread(graphics_thread, "render", NULL);
 	
 	// Splash screen before loading
 	splashScreen();
 }
 
 void graphics_destroy() {
-	SDL_DestroyRenderer(renderer);
+	if(headless || !render_thread)
+		return;
+	
+	atomic_store(&render_stop, 1);
+	SDL_SemPost(frame_posted);
+	SDL_WaitThread(render_thread, NULL);
+	SDL_DestroySemaphore(frame_posted);
+	render_thread = NULL;
+	
 	SDL_DestroyWindow(window);
 	SDL_Quit();
 }
 
+/**
+	Hand window events to the core through the input queue, called
+	on the main thread once per frame and when the game reads P1
+*/
+void graphics_pollEvents() {
+	SDL_Event event;
+	unsigned short button;
+	
+	if(headless)
+		return;
+	
+	// States that did not fit into the queue last time
+	input_flush();
+	while(SDL_PollEvent(&event)) {
+		switch(event.type)
+		{
+			case SDL_QUIT:
+				input_push(INPUT_QUIT, 1, eventTime(&event));
+				break;
+			case SDL_KEYDOWN:
+			case SDL_KEYUP:
+				button = keyButton(event.key.keysym.sym);
+				if(button && !event.key.repeat)
+					input_push(button, event.type == SDL_KEYDOWN, eventTime(&event));
+				break;
+		}
+	}
+}
+
 void graphics_screen_off() {
-	graphics_setColor(0, 0, 0, 255);
-	graphics_clearScreen();
+	if(headless)
+		return;
+	
+	for(int i = 0; i < LCD_SCREEN_WIDTH * LCD_SCREEN_HEIGHT; i++)
+		graphics_framebuffer[i] = GRAPHICS_BLACK;
+	memset(graphics_signatures, GRAPHICS_UNKNOWN_LINE, sizeof(signatures[0]));
 	graphics_render();
 }
 
-void graphics_setColor(int r, int g, int b, int a) {
-	SDL_SetRenderDrawColor(renderer, r, g, b, a);
-}
-void graphics_drawPixel(int x, int y) {
-	if(x < 0 || x > LCD_SCREEN_WIDTH || y < 0 || y > LCD_SCREEN_HEIGHT) {
-		printf("OOB\n");
+/**
+	Hand the finished frame to the render thread and continue
+	with the oldest buffer, never blocks
+*/
+void graphics_render() {
+	if(headless)
 		return;
-	}
+	
+	back = atomic_exchange_explicit(&ready, back | GRAPHICS_FRESH, memory_order_acq_rel) & 0x3;
+	graphics_framebuffer = framebuffers[back];
+	graphics_signatures = signatures[back];
+	SDL_SemPost(frame_posted);
+}
 
-	x *= GRAPHICS_SCALE;
-	y *= GRAPHICS_SCALE;
+/**
+Static Functions
+*/
+static int graphics_thread(void * unused) {
+	SDL_Renderer * renderer;
+	SDL_Texture * texture;
+	unsigned long long start;
+	unsigned long long shown[LCD_SCREEN_HEIGHT];
+	int front;
+	
+	// The renderer is only used by the thread that created it
+	// Waiting for vsync only holds up this thread now
+	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+	texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+		LCD_SCREEN_WIDTH, LCD_SCREEN_HEIGHT);
+	
+	front = 2;
+	memset(shown, GRAPHICS_UNKNOWN_LINE, sizeof(shown));
+	while(!atomic_load(&render_stop)) {
+		// Wake up to check render_stop even without new frames
+		SDL_SemWaitTimeout(frame_posted, 16);
+		if(!(atomic_load_explicit(&ready, memory_order_relaxed) & GRAPHICS_FRESH))
+			continue;
+		front = atomic_exchange_explicit(&ready, front, memory_order_acq_rel) & 0x3;
 		
-	for(int i = 0; i < GRAPHICS_SCALE; i++) {
-		for(int j = 0; j < GRAPHICS_SCALE; j++) {
-			SDL_RenderDrawPoint(renderer, x + i, y + j);
-		}
+		start = timeline_enabled ? timeline_now() : 0;
+		updateTexture(texture, front, shown);
+		SDL_RenderCopy(renderer, texture, NULL, NULL);
+		SDL_RenderPresent(renderer);
+		if(timeline_enabled)
+			timeline_span("present", "present", start, timeline_now(), TIMELINE_RENDER);
 	}
-}
-void graphics_clearScreen() {
-	SDL_RenderClear(renderer);
-}
-void graphics_render() {
-	SDL_RenderPresent(renderer);
+	
+	SDL_DestroyTexture(texture);
+	SDL_DestroyRenderer(renderer);
+	
+	return 0;
 }
 
-void graphics_update() {
-	SDL_Event event;
+/**
+	Uploads the runs of lines whose signature differs from the one
+	shown, a static picture costs no upload at all
+*/
+static void updateTexture(SDL_Texture * texture, int front, unsigned long long * shown) {
+	unsigned long long * frame;
+	SDL_Rect rect;
+	int y, end;
 	
-	SDL_PollEvent(&event);
-	switch(event.type)
+	frame = signatures[front];
+	for(y = 0; y < LCD_SCREEN_HEIGHT; y = end) {
+		end = y + 1;
+		if(frame[y] != GRAPHICS_UNKNOWN_LINE && frame[y] == shown[y])
+			continue;
+		
+		while(end < LCD_SCREEN_HEIGHT && (frame[end] == GRAPHICS_UNKNOWN_LINE || frame[end] != shown[end]))
+			end++;
+		rect.x = 0;
+		rect.y = y;
+		rect.w = LCD_SCREEN_WIDTH;
+		rect.h = end - y;
+		SDL_UpdateTexture(texture, &rect, framebuffers[front] + y * LCD_SCREEN_WIDTH, LCD_SCREEN_WIDTH * sizeof(unsigned int));
+		memcpy(shown + y, frame + y, (end - y) * sizeof(*shown));
+	}
+}
+
+static unsigned short keyButton(SDL_Keycode key) {
+	switch(key)
 	{
-		case SDL_QUIT:
-			graphics_destroy();
-			cpu_state.running = 0;
-			break;
+		case SDLK_RIGHT:     return INPUT_RIGHT;
+		case SDLK_LEFT:      return INPUT_LEFT;
+		case SDLK_UP:        return INPUT_UP;
+		case SDLK_DOWN:      return INPUT_DOWN;
+		case SDLK_z:         return INPUT_A;
+		case SDLK_x:         return INPUT_B;
+		case SDLK_BACKSPACE: return INPUT_SELECT;
+		case SDLK_RETURN:    return INPUT_START;
+		case SDLK_TAB:       return INPUT_TURBO;
 	}
+	return 0;
+}
+
+/**
+	When the window system got the event, on the input_now() clock,
+	so latencies include the time it waited in SDL's queue.
+	SDL timestamps only have millisecond resolution.
+*/
+static unsigned long long eventTime(const SDL_Event * event) {
+	return input_now() - (SDL_GetTicks() - event->common.timestamp) * 1000ull;
 }
 
 static void splashScreen() {
 	float gradient;
 	
-	graphics_clearScreen();
 	gradient = 255.0 / LCD_SCREEN_WIDTH;
 	for(int i = 0, c; i < LCD_SCREEN_HEIGHT; i++) {
 		c = i * gradient;
-		graphics_setColor(64, c, c, 0);
 		for(int j = 0; j < LCD_SCREEN_WIDTH; j++)
-			graphics_drawPixel(j, i);
+			graphics_framebuffer[i * LCD_SCREEN_WIDTH + j] = 0xFF400000 | c << 8 | c;
 	}
+	memset(graphics_signatures, GRAPHICS_UNKNOWN_LINE, sizeof(signatures[0]));
 	graphics_render();
 }
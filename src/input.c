@@ -0,0 +1,124 @@
+#include <time.h>
+
+#include "input.h"
+#include "cpu.h"
+#include "lcd.h"
+
+/**
+Global variables
+*/
+unsigned char input_buttons;
+unsigned long long input_pressed_at[8];
+
+/**
+Static Variables
+*/
+static struct input_queue input_queue;
+
+// Frontend side: the latest state of every button, and the buttons
+// whose latest state did not fit into the queue yet
+static unsigned short frontend_held;
+static unsigned short frontend_unsent;
+static unsigned long long frontend_times[INPUT_BITS];
+
+/**
+Functions
+*/
+/**
+	Microseconds, for input latency
+*/
+unsigned long long input_now() {
+	struct timespec now;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000ull + now.tv_nsec / 1000;
+}
+
+/**
+	Frontend side, time is when the event happened on the input_now()
+	clock. When the queue is full the button's latest state is kept
+	and sent by a later input_push() or input_flush(), so a release or
+	a quit is never lost. Returns 0 if something is still waiting for
+	room in the queue.
+*/
+char input_push(unsigned short button, char pressed, unsigned long long time) {
+	int i;
+	
+	if(pressed)
+		frontend_held |= button;
+	else
+		frontend_held &= ~button;
+	frontend_unsent |= button;
+	for(i = 0; i < INPUT_BITS; i++) {
+		if(button & (1 << i))
+			frontend_times[i] = time;
+	}
+	
+	return input_flush();
+}
+
+/**
+	Frontend side, sends the buttons input_push() could not,
+	returns 0 if the queue is still full
+*/
+char input_flush() {
+	unsigned int head;
+	unsigned short button;
+	struct input_event * event;
+	int i;
+	
+	head = input_queue.head;
+	while(frontend_unsent) {
+		if(head - input_queue.tail == INPUT_QUEUE_SIZE)
+			return 0;
+		
+		// Lowest bit first
+		button = frontend_unsent & -frontend_unsent;
+		for(i = 0; !(button & (1 << i)); i++);
+		event = &input_queue.events[head & (INPUT_QUEUE_SIZE - 1)];
+		event->button = button;
+		event->pressed = (frontend_held & button) ? 1 : 0;
+		event->time = frontend_times[i];
+		input_queue.head = ++head;
+		frontend_unsent &= ~button;
+	}
+	return 1;
+}
+
+/**
+	Core side, applies everything queued since the last call and
+	returns the buttons that were pressed in the meantime
+*/
+unsigned char input_poll() {
+	unsigned int head, tail, i;
+	unsigned char pressed;
+	struct input_event * event;
+	
+	tail = input_queue.tail;
+	head = input_queue.head;
+	if(head == tail)
+		return 0;
+	
+	pressed = 0;
+	for(; tail != head; tail++) {
+		event = &input_queue.events[tail & (INPUT_QUEUE_SIZE - 1)];
+		if(event->button == INPUT_QUIT) {
+			cpu_state.running = 0;
+		} else if(event->button == INPUT_TURBO) {
+			if(event->pressed)
+				lcd_setTurbo(!lcd_turbo);
+		} else if(event->pressed) {
+			input_buttons |= event->button;
+			pressed |= event->button;
+			for(i = 0; i < 8; i++) {
+				if(event->button & (1 << i))
+					input_pressed_at[i] = event->time;
+			}
+		} else {
+			input_buttons &= ~event->button;
+		}
+	}
+	input_queue.tail = tail;
+	
+	return pressed;
+}
@@ -1,6 +1,7 @@
 #include "interrupt.h"
 #include "memory.h"
 #include "cpu.h"
+#include "profiler.h"
 
 static char * _interrupt_enable;
 static char * _interrupt_waiting;
@@ -10,6 +11,10 @@ void interrupt_init() {
 	_interrupt_waiting = memory_dump() + 0xFF0F;
 }
 
+char interrupt_pending() {
+	return (*_interrupt_waiting) & (*_interrupt_enable);
+}
+
 void interrupt_handle() {
 	char process_interrupts;
 	
@@ -61,6 +66,9 @@ void interrupt_handle() {
 			// Clear Flag
 			*_interrupt_waiting ^= 0x10;
 		}
+		
+		if(profiler_callgraph)
+			profiler_interrupt(cpu_state.registers.PC, cpu_state.registers.SP);
 	}
 }
 
@@ -0,0 +1,122 @@
+#include "joypad.h"
+#include "memory.h"
+#include "interrupt.h"
+#include "input.h"
+#include "graphics.h"
+
+/**
+Static Functions
+*/
+static unsigned char selectedLines(unsigned char select, unsigned char buttons);
+
+/**
+Global variables
+*/
+unsigned long long joypad_latency[JOYPAD_LATENCY_BUCKETS];
+
+/**
+Static Variables
+*/
+// Pressed, but not read by the game yet
+static unsigned char unseen;
+static unsigned long long last_events;
+
+/**
+Functions
+*/
+/**
+	Take queued input, a press on a selected line requests
+	the joypad interrupt
+*/
+void joypad_update() {
+	unsigned char pressed, select;
+	
+	pressed = input_poll();
+	if(!pressed)
+		return;
+	
+	unseen |= pressed;
+	select = *((unsigned char *)memory_dump() + 0xFF00);
+	if(selectedLines(select, pressed))
+		interrupt_trigger(JOYPAD_INTERRUPT);
+}
+
+/**
+	The buttons are sampled at the moment the game reads P1, with
+	the window events up to then, the select bits are what the game
+	last wrote
+*/
+unsigned char joypad_read() {
+	unsigned char select, lines, seen;
+	unsigned long long now, latency;
+	int i, bucket;
+	
+	// Games read P1 several times in a row, polling the window once
+	// per JOYPAD_EVENTS_INTERVAL is as fresh and much cheaper
+	now = input_now();
+	if(now - last_events >= JOYPAD_EVENTS_INTERVAL) {
+		graphics_pollEvents();
+		last_events = now;
+	}
+	joypad_update();
+	select = *((unsigned char *)memory_dump() + 0xFF00) & (JOYPAD_SELECT_BUTTONS | JOYPAD_SELECT_DIRECTIONS);
+	lines = selectedLines(select, input_buttons);
+	
+	// Time from the key event to the game seeing it
+	seen = unseen & input_buttons & (
+		(select & JOYPAD_SELECT_DIRECTIONS ? 0 : 0x0F) |
+		(select & JOYPAD_SELECT_BUTTONS ? 0 : 0xF0)
+	);
+	if(seen) {
+		now = input_now();
+		for(i = 0; i < 8; i++) {
+			if(!(seen & (1 << i)))
+				continue;
+			latency = now - input_pressed_at[i];
+			for(bucket = 0; bucket < JOYPAD_LATENCY_BUCKETS - 1 && latency >= (1ull << bucket); bucket++);
+			joypad_latency[bucket]++;
+		}
+		unseen &= ~seen;
+	}
+	
+	// Unused bits read as 1, lines are active low
+	return 0xC0 | select | (~lines & 0x0F);
+}
+
+void joypad_report(FILE * fp) {
+	unsigned long long total;
+	char label[32];
+	int i;
+	
+	total = 0;
+	for(i = 0; i < JOYPAD_LATENCY_BUCKETS; i++)
+		total += joypad_latency[i];
+	if(!total)
+		return;
+	
+	fprintf(fp, "[joypad] %llu presses read by the game\n", total);
+	fprintf(fp, "%-16s %10s %8s\n", "Latency", "Presses", "%");
+	for(i = 0; i < JOYPAD_LATENCY_BUCKETS; i++) {
+		if(!joypad_latency[i])
+			continue;
+		sprintf(label, "< %llu us", 1ull << i);
+		fprintf(fp, "%-16s %10llu %7.2f%%\n", label, joypad_latency[i], 100.0 * joypad_latency[i] / total);
+	}
+}
+
+/**
+Static Functions
+*/
+/**
+	Lines pulled low by the pressed buttons in the selected groups
+*/
+static unsigned char selectedLines(unsigned char select, unsigned char buttons) {
+	unsigned char lines;
+	
+	lines = 0;
+	if(!(select & JOYPAD_SELECT_DIRECTIONS))
+		lines |= buttons & 0x0F;
+	if(!(select & JOYPAD_SELECT_BUTTONS))
+		lines |= buttons >> 4;
+	return lines;
+}
@@ -4,11 +4,65 @@
 #include "ioports.h"
 #include "graphics.h"
 #include "interrupt.h"
+#include "profiler.h"
+#include "timeline.h"
+#include "perf.h"
+
+/**
+Deferred rendering
+Register writes and drawn lines are logged during the frame and
+replayed against a copy of the registers at VBlank. Replay is per
+line like eager drawing: a line sees every write made before the
+end of its mode 3.
+*/
+#define LCD_LOG_SIZE 1024
+#define LCD_LOG_LINE 0x00 // Entry draws lcdc_y instead of writing a register
+
+struct lcd_log_entry {
+	unsigned char address; // Offset from $FF00, or LCD_LOG_LINE
+	unsigned char value;
+};
+
+/**
+Sprites (OBJ)
+*/
+#define LCD_SPRITES          40
+#define LCD_SPRITES_PER_LINE 10
+
+struct lcd_sprite {
+	unsigned char y;     // Screen position + 16
+	unsigned char x;     // Screen position + 8
+	unsigned char tile;
+	unsigned char flags;
+};
+#define SPRITE_BEHIND_BG 0x80 // Only drawn over BG color 0
+#define SPRITE_FLIP_Y    0x40
+#define SPRITE_FLIP_X    0x20
+#define SPRITE_OBP1      0x10
+
+#define LCD_TILES 384 // $8000-$97FF
+
+/**
+BG maps ($9800 and $9C00) kept as 256x256 bitmaps of color numbers,
+VRAM writes mark the map entries and tiles to redraw
+*/
+#define LCD_MAP_ENTRIES 0x400
 
 /**
 Static Functions
 */
-static void drawScanline();
+static void drawScanline(const struct lcd_registers * regs);
+static void copyMapRow(unsigned char map, unsigned char y, unsigned char x, int pixel, int end, unsigned char * colors);
+static void updateMap(unsigned char map, unsigned char tile_data_region);
+static unsigned short mapTile(unsigned char map, unsigned short entry);
+static const unsigned char * tileRow(unsigned short tile, unsigned char row);
+static void drawSprites(const struct lcd_registers * regs, unsigned int * line, const unsigned char * bg_colors);
+static unsigned short spriteRow(const struct lcd_sprite * sprite, unsigned char y, unsigned char height);
+static unsigned long long lineSignature(const struct lcd_registers * regs, int bg_end, int window_start);
+static unsigned long long mixSignature(unsigned long long signature, unsigned long long value);
+static void buildSpriteLists(unsigned char height);
+static void logEntry(unsigned char address, unsigned char value);
+static void replayLog();
 
 /**
 Static Variables
@@ -16,6 +70,42 @@ Static Variables
 static struct lcd_registers * lcd_registers;
 static char * vram;
 
+char lcd_deferred;
+static struct lcd_log_entry lcd_log[LCD_LOG_SIZE];
+static unsigned int lcd_log_length;
+static struct lcd_registers replay_registers;
+
+static const unsigned int shades[4] = {
+	GRAPHICS_WHITE, GRAPHICS_LIGHT_GRAY, GRAPHICS_DARK_GRAY, GRAPHICS_BLACK
+};
+
+// Sprites on each line in drawing priority, rebuilt when OAM changes
+static struct lcd_sprite * oam;
+static unsigned char sprite_lines[LCD_SCREEN_HEIGHT][LCD_SPRITES_PER_LINE];
+static unsigned char sprite_counts[LCD_SCREEN_HEIGHT];
+static unsigned char sprite_height;
+static char oam_changed = 1;
+
+// Decoded tile rows, shared by the BG, the window and sprites
+static unsigned char tile_rows[LCD_TILES][8][8];
+static unsigned short tile_raw[LCD_TILES][8];
+static unsigned char window_line;
+
+static unsigned char map_pixels[2][256][256];
+static signed char map_region[2] = {-1, -1}; // Tile data region the bitmap was drawn with
+static unsigned char map_dirty[2][LCD_MAP_ENTRIES];
+static char map_changed[2];
+static unsigned int map_versions[2][32]; // Per map row, changes whenever its pixels do
+static unsigned char tile_dirty[LCD_TILES];
+static char tiles_changed;
+
+static char skip_unchanged = 1;
+
+char lcd_turbo;
+static unsigned int turbo_interval = LCD_TURBO_INTERVAL;
+static unsigned int turbo_frames;
+static char frame_drawn = 1;
+
 void lcd_init() {
 	vram = memory_dump();
 	
@@ -24,32 +114,75 @@ void lcd_init() {
 	
 	// Correct the offset to VRAM
 	vram += 0x8000;
+	
+	oam = (void*)memory_dump() + 0xFE00;
+}
+
+/**
+	Forget everything derived from VRAM, OAM and earlier frames after
+	memory was reset, so the next frame is built from scratch
+*/
+void lcd_reset() {
+	oam_changed = 1;
+	window_line = 0;
+	
+	// Versions only ever move forward, signatures of lines drawn
+	// before the reset can never match again
+	for(int m = 0; m < 2; m++) {
+		memset(map_dirty[m], 1, sizeof(map_dirty[m]));
+		map_changed[m] = 1;
+		map_region[m] = -1;
+		for(int row = 0; row < 32; row++)
+			map_versions[m][row]++;
+	}
+	memset(tile_dirty, 0, sizeof(tile_dirty));
+	tiles_changed = 0;
+	memset(graphics_signatures, GRAPHICS_UNKNOWN_LINE, LCD_SCREEN_HEIGHT * sizeof(*graphics_signatures));
+	
+	lcd_log_length = 0;
+	replay_registers = *lcd_registers;
+	turbo_frames = 0;
+	frame_drawn = 1;
 }
 
+/**
+	The cycles so far still count towards what ran before the
+	transfer, lines still pending are drawn with the old OAM
+*/
 void lcd_dma_transfer(unsigned char val) {
 	char * mem;
 	
+	lcd_sync();
+	
 	// Lock everything except HRAM
 	memory_lockRegion(LRAM_LOCK, MEMORY_READ | MEMORY_WRITE);
 	
 	// Do transfer
 	mem = memory_dump();
 	memcpy(mem + 0xFE00, mem + (0x100 * val), 0xA0);
+	oam_changed = 1;
 	
 	// Takes 160 (0xA0) cycles to complete
 	cpu_state.dma_transfer = 160;
-
+	
 	// Unlock LRAM
 	memory_lockRegion(LRAM_LOCK, 0);
 }
 
-void lcd_update(unsigned char cycles) {
-	if(cpu_state.dma_transfer > 0) cpu_state.dma_transfer -= cycles;
-
+/**
+	Step the LCD by cycles, at most one state change per call
+	Runs behind the CPU, see lcd_sync
+*/
+void lcd_update(unsigned int cycles) {
+	if(cpu_state.dma_transfer > 0)
+		cpu_state.dma_transfer = cycles < cpu_state.dma_transfer ? cpu_state.dma_transfer - cycles : 0;
+	
 	// Determine if LCD Display is enabled
 	static char graphics_disabled = 0;
 	if((lcd_registers->lcdc_control >> 7) ^ 0x1) {
 		if(!graphics_disabled) {
+			if(lcd_deferred)
+				replayLog();
 			graphics_screen_off();
 			graphics_disabled = 1;
 		}
@@ -70,11 +203,32 @@ void lcd_update(unsigned char cycles) {
 			
 			// Move to the next line
 			lcd_registers->lcdc_y++;
+			if(timeline_enabled)
+				timeline_line(lcd_registers->lcdc_y);
 			
 			// Goto V_BLANK or OAM Scanline
-			if(lcd_registers->lcdc_y >= 143)
+			if(lcd_registers->lcdc_y >= 143) {
 				lcd_registers->lcdc_status |= 0x1; // V_BLANK
-			else
+				cpu_state.total_frames++;
+				if(lcd_deferred)
+					replayLog();
+				if(frame_drawn) {
+					PHASE_BEGIN(PHASE_RENDER);
+					graphics_render();
+					PHASE_END();
+				}
+				
+				// Turbo draws one frame in turbo_interval, or none
+				turbo_frames++;
+				frame_drawn = !lcd_turbo || (turbo_interval && turbo_frames % turbo_interval == 0);
+#ifdef PROFILE_PHASES
+				profiler_phaseFrame();
+#endif
+				if(timeline_enabled)
+					timeline_vblank(1);
+				if(perf_enabled)
+					perf_frame();
+			} else
 				lcd_registers->lcdc_status |= 0x2; // OAM
 			
 			break;
@@ -94,6 +248,8 @@ void lcd_update(unsigned char cycles) {
 				
 				// Set line to 0
 				lcd_registers->lcdc_y = 0;
+				if(timeline_enabled)
+					timeline_vblank(0);
 			}
 			break;
 		case 2:
@@ -106,7 +262,14 @@ void lcd_update(unsigned char cycles) {
 		case 3:
 			// Scanline (VRAM)
 			// Render scanline now
-			drawScanline();
+			// Only timing is kept for frames turbo does not draw
+			if(frame_drawn && lcd_deferred) {
+				logEntry(LCD_LOG_LINE, lcd_registers->lcdc_y);
+			} else if(frame_drawn) {
+				PHASE_BEGIN(PHASE_SCANLINE);
+				drawScanline(lcd_registers);
+				PHASE_END();
+			}
 			
 			cpu_state.lcd_wait_cycles += 172;
 			
@@ -122,15 +285,160 @@ void lcd_update(unsigned char cycles) {
 		lcd_registers->lcdc_status &= ~4; // Clear bit
 }
 
-static void drawScanline() {
-	unsigned short vram_offset;
-	unsigned char tile_data_region, bg_display_region;
-	unsigned char tile_row, tile_col, pixel;
-	char tileID, *tile, tile_line;
-	char bits, i;
+/**
+	VRAM was written, map bitmaps are redrawn where it shows before
+	they are used again
+*/
+void lcd_vramChanged(unsigned short address, unsigned int len) {
+	unsigned int end;
+	
+	end = address + len;
+	if(end > 0xA000)
+		end = 0xA000;
+	for(unsigned int i = address < 0x8000 ? 0x8000 : address; i < end; i++) {
+		if(i < 0x9800) {
+			tile_dirty[(i - 0x8000) / LCD_TILE_SIZE] = 1;
+			tiles_changed = 1;
+		} else {
+			map_dirty[(i - 0x9800) / LCD_MAP_ENTRIES][i % LCD_MAP_ENTRIES] = 1;
+			map_changed[(i - 0x9800) / LCD_MAP_ENTRIES] = 1;
+		}
+	}
+}
+
+/**
+	Fast forward, the LCD keeps its timing (LY, STAT, interrupts)
+	but only draws and presents one frame in lcd_setTurboInterval().
+	Takes effect at the next VBlank, the main loop stops pacing frames.
+*/
+void lcd_setTurbo(char enabled) {
+	lcd_turbo = enabled;
+	turbo_frames = 0;
+}
+
+/**
+	Frames per drawn frame in turbo, 0 draws nothing at all
+*/
+void lcd_setTurboInterval(unsigned int frames) {
+	turbo_interval = frames;
+}
+
+/**
+	Draw every line even if it is the same as the one in the
+	framebuffer, for measuring the drawing itself
+*/
+void lcd_setSkipUnchanged(char enabled) {
+	skip_unchanged = enabled;
+}
+
+/**
+	OAM was written, the sprite lists are rebuilt before the next line
+*/
+void lcd_oamChanged() {
+	oam_changed = 1;
+}
+
+/**
+	Catch the LCD up to cpu_state.total_cycles
+	
+	Between state changes lcd_update only counts down, so the CPU calls
+	this once cpu_state.lcd_next_sync is reached instead of after every
+	instruction. Mode, LY, STAT and the VBlank interrupt change at the
+	same instruction as stepping eagerly, so nothing the CPU can read or
+	write (registers, VRAM, OAM) needs an extra sync. Only LCDC decides
+	whether cycles count at all, see lcd_writeControl.
+*/
+void lcd_sync() {
+	unsigned long long pending;
+	
+	pending = cpu_state.total_cycles - cpu_state.lcd_synced_cycles;
+	cpu_state.lcd_synced_cycles = cpu_state.total_cycles;
+	
+	// Cycles are ignored while the display is off
+	lcd_update(pending > 0xFFFF ? 0xFFFF : pending);
+	
+	if((lcd_registers->lcdc_control >> 7) ^ 0x1)
+		cpu_state.lcd_next_sync = ~0ull;
+	else
+		cpu_state.lcd_next_sync = cpu_state.total_cycles + cpu_state.lcd_wait_cycles;
+}
+
+/**
+	The cycles so far still count with the old LCDC, the writing
+	instruction is stepped with the new one
+*/
+void lcd_writeControl(unsigned char val) {
+	lcd_sync();
+	lcd_registers->lcdc_control = val;
+	cpu_state.lcd_next_sync = cpu_state.total_cycles;
+	if(lcd_deferred)
+		logEntry(0x40, val);
+}
+
+/**
+	Render whole frames at VBlank instead of every line at the end of
+	mode 3. Raster effects through the LCD registers stay intact, VRAM
+	and OAM are read as they are at VBlank.
+*/
+void lcd_setDeferred(char enabled) {
+	if(lcd_deferred)
+		replayLog();
+	lcd_deferred = enabled;
+	replay_registers = *lcd_registers;
+}
+
+/**
+	Called after the CPU wrote an LCD register (except LCDC)
+*/
+void lcd_logWrite(unsigned short address, unsigned char val) {
+	switch(address) {
+		case 0xFF42: // SCY
+		case 0xFF43: // SCX
+		case 0xFF47: // BGP
+		case 0xFF48: // OBP0
+		case 0xFF49: // OBP1
+		case 0xFF4A: // WY
+		case 0xFF4B: // WX
+			// Lines due before this instruction are logged first
+			lcd_sync();
+			logEntry(address & 0xFF, val);
+			break;
+	}
+}
+
+/**
+	Number of cycles that can pass before lcd_update would
+	change any state (mode, LY, interrupts or DMA)
+*/
+unsigned int lcd_idleCycles() {
+	lcd_sync();
+	
+	// DMA counts down per instruction, so never skip over it
+	if(cpu_state.dma_transfer > 0)
+		return 0;
 	
-	// Get the row of the tile too look at (The '/8' is needed (integer division))
-	tile_row = ((lcd_registers->lcdc_y + lcd_registers->scroll_y) / 8);
+	// Display disabled, nothing happens until LCDC is written
+	if((lcd_registers->lcdc_control >> 7) ^ 0x1)
+		return ~0u;
+	
+	return cpu_state.lcd_wait_cycles > 0 ? cpu_state.lcd_wait_cycles - 1 : 0;
+}
+
+static void drawScanline(const struct lcd_registers * regs) {
+	unsigned char tile_data_region, bg_display_region, window_display_region;
+	unsigned int palette[4], * line;
+	unsigned char bg_colors[LCD_SCREEN_WIDTH], height;
+	unsigned long long signature;
+	int window_start, bg_end;
+	
+	if(regs->lcdc_y >= LCD_SCREEN_HEIGHT)
+		return;
+	line = graphics_framebuffer + regs->lcdc_y * LCD_SCREEN_WIDTH;
+	
+	// The window has its own line counter, it only advances on
+	// lines where the window was drawn
+	if(regs->lcdc_y == 0)
+		window_line = 0;
 	
 	/**
 		Bit 4 == 1 << 4 == 16
@@ -138,7 +446,7 @@ static void drawScanline() {
 		1 - 0x8000->0x8FFF (unsigned)
 		0 - 0x8800->0x97FF (signed)
 	*/
-	tile_data_region = (lcd_registers->lcdc_control & 16) ? 1 : 0;
+	tile_data_region = (regs->lcdc_control & 16) ? 1 : 0;
 	
 	/**
 		Bit 3 == 1 << 3 == 8
@@ -146,73 +454,346 @@ static void drawScanline() {
 		1 - 0x9C00->0x9FFF
 		0 - 0x9800->0x9BFF
 	*/
-	bg_display_region = (lcd_registers->lcdc_control & 8) ? 1 : 0;
+	bg_display_region = (regs->lcdc_control & 8) ? 1 : 0;
+	
+	/**
+		Bit 6 == 1 << 6 == 64
+		
+		1 - 0x9C00->0x9FFF
+		0 - 0x9800->0x9BFF
+	*/
+	window_display_region = (regs->lcdc_control & 64) ? 1 : 0;
+	
+	// Bit 5 - Window Display Enable, WX is the screen position + 7
+	window_start = LCD_SCREEN_WIDTH;
+	if((regs->lcdc_control & 0x20) && regs->lcdc_y >= regs->window_y && regs->window_x < LCD_SCREEN_WIDTH + 7)
+		window_start = regs->window_x - 7;
+	
+	// BG up to the window, a window from the left edge (HUDs, menus)
+	// covers the line and the BG is not looked at
+	bg_end = window_start < LCD_SCREEN_WIDTH ? window_start : LCD_SCREEN_WIDTH;
 	
 #ifdef DEBUG_LCD
 	printf("Tile Region: %d\n", tile_data_region);
 	printf("Background Region: %d\n", bg_display_region);
-	printf("Scroll (X, Y): (%d, %d)\n", lcd_registers->scroll_x, lcd_registers->scroll_y);
-	printf("LCDC_Y: %d\n", lcd_registers->lcdc_y);
-	printf("Tile Row: %d\n", tile_row);
+	printf("Window Region: %d\n", window_display_region);
+	printf("Scroll (X, Y): (%d, %d)\n", regs->scroll_x, regs->scroll_y);
+	printf("Window (X, Y): (%d, %d), line %d\n", regs->window_x, regs->window_y, window_line);
+	printf("LCDC_Y: %d\n", regs->lcdc_y);
 #endif
-	/**
-		Screen Width == 160
-		Tile Width   == 8
-		Since we draw 8 pixels at a time, only loop LCD_SCREEN_WIDTH / 8 times
-	*/
-	for(pixel = 0; pixel < LCD_SCREEN_WIDTH; pixel++) {
-		tile_col = (lcd_registers->scroll_x + pixel) / 8;
+	// Bring the maps and sprite lists up to date, the signature
+	// is taken from them
+	if(regs->lcdc_control & 0x1) {
+		if(bg_end > 0)
+			updateMap(bg_display_region, tile_data_region);
+		if(window_start < LCD_SCREEN_WIDTH)
+			updateMap(window_display_region, tile_data_region);
+	}
+	if(regs->lcdc_control & 0x2) {
+		// Bit 2 - OBJ size, 0 = 8x8, 1 = 8x16
+		height = (regs->lcdc_control & 0x4) ? 16 : 8;
+		if(oam_changed || height != sprite_height)
+			buildSpriteLists(height);
+	}
+	
+	signature = lineSignature(regs, bg_end, window_start);
+	if(skip_unchanged && graphics_signatures[regs->lcdc_y] == signature) {
+		if((regs->lcdc_control & 0x1) && window_start < LCD_SCREEN_WIDTH)
+			window_line++;
+		return;
+	}
+	graphics_signatures[regs->lcdc_y] = signature;
+	
+	if(regs->lcdc_control & 0x1) {
+		// BG Display Enabled
+		for(int i = 0; i < 4; i++)
+			palette[i] = shades[(regs->bgp >> (i * 2)) & 0x3];
 		
-		if(lcd_registers->lcdc_control & 0x1) {
-			// BG Display Enabled
-			
-			// Get the tileID from BG Map Data
-			tileID = *(vram + (bg_display_region ? 0x1C00 : 0x1800) + tile_row * 32 + tile_col);
-			
-			// Get the offset into vram
-			if(tile_data_region) {
-				vram_offset = ((unsigned)tileID) * LCD_TILE_SIZE;
-			} else {
-				vram_offset = 0x800;
-				vram_offset += (tileID + 128) * LCD_TILE_SIZE;
+		if(bg_end > 0)
+			copyMapRow(bg_display_region, regs->lcdc_y + regs->scroll_y, regs->scroll_x, 0, bg_end, bg_colors);
+		
+		if(window_start < LCD_SCREEN_WIDTH) {
+			// WX below 7 cuts off the left of the window
+			copyMapRow(window_display_region, window_line, window_start < 0 ? -window_start : 0,
+				window_start < 0 ? 0 : window_start, LCD_SCREEN_WIDTH, bg_colors);
+			window_line++;
+		}
+		
+		for(int pixel = 0; pixel < LCD_SCREEN_WIDTH; pixel++)
+			line[pixel] = palette[bg_colors[pixel]];
+	} else {
+		// Also hides the window
+		for(int pixel = 0; pixel < LCD_SCREEN_WIDTH; pixel++)
+			line[pixel] = GRAPHICS_WHITE;
+		memset(bg_colors, 0, sizeof(bg_colors));
+	}
+	
+	if(regs->lcdc_control & 0x2) {
+		// OBJ (Sprite) Display Enabled
+		drawSprites(regs, line, bg_colors);
+	}
+}
+
+/**
+	Everything the line is drawn from: the registers, the version of
+	the map rows it copies and the sprites on it with their tile rows.
+	Never GRAPHICS_UNKNOWN_LINE.
+*/
+static unsigned long long lineSignature(const struct lcd_registers * regs, int bg_end, int window_start) {
+	unsigned long long signature;
+	const unsigned char * raw;
+	struct lcd_sprite * sprite;
+	unsigned char n;
+	
+	// Every term is widened first, an int shift into bit 31 would sign extend over the higher ones
+	signature = mixSignature(regs->lcdc_y, (unsigned long long)regs->lcdc_control | (unsigned long long)regs->scroll_y << 8 |
+		(unsigned long long)regs->scroll_x << 16 | (unsigned long long)regs->bgp << 24 |
+		(unsigned long long)regs->obp0 << 32 | (unsigned long long)regs->obp1 << 40);
+	
+	if(regs->lcdc_control & 0x1) {
+		if(bg_end > 0)
+			signature = mixSignature(signature, (unsigned long long)bg_end << 32 |
+				map_versions[(regs->lcdc_control & 8) ? 1 : 0][((regs->lcdc_y + regs->scroll_y) & 0xFF) / 8]);
+		if(window_start < LCD_SCREEN_WIDTH)
+			signature = mixSignature(signature, (unsigned long long)(window_start + 7) << 40 | (unsigned long long)window_line << 32 |
+				map_versions[(regs->lcdc_control & 64) ? 1 : 0][window_line / 8]);
+	}
+	
+	if(regs->lcdc_control & 0x2) {
+		for(n = 0; n < sprite_counts[regs->lcdc_y]; n++) {
+			sprite = &oam[sprite_lines[regs->lcdc_y][n]];
+			raw = (unsigned char *)vram + spriteRow(sprite, regs->lcdc_y, sprite_height) * 2;
+			signature = mixSignature(signature, (unsigned long long)sprite->y | (unsigned long long)sprite->x << 8 |
+				(unsigned long long)sprite->tile << 16 | (unsigned long long)sprite->flags << 24 |
+				(unsigned long long)raw[0] << 32 | (unsigned long long)raw[1] << 40);
+		}
+	}
+	
+	return signature == GRAPHICS_UNKNOWN_LINE ? 1 : signature;
+}
+
+static unsigned long long mixSignature(unsigned long long signature, unsigned long long value) {
+	signature = (signature ^ value) * 0x9E3779B97F4A7C15ull;
+	return signature ^ (signature >> 29);
+}
+
+/**
+	Copies the map bitmap from pixel x of line y to the screen pixels
+	from pixel up to end, wrapping around the 256 pixel wide map like
+	the BG does
+*/
+static void copyMapRow(unsigned char map, unsigned char y, unsigned char x, int pixel, int end, unsigned char * colors) {
+	const unsigned char * row;
+	int n;
+	
+	row = map_pixels[map][y];
+	while(pixel < end) {
+		n = 256 - x;
+		if(n > end - pixel)
+			n = end - pixel;
+		memcpy(colors + pixel, row + x, n);
+		pixel += n;
+		x = 0;
+	}
+}
+
+/**
+	Redraws the tiles of a map bitmap that changed since it was last
+	used, and all of it if it was drawn with the other tile data region
+*/
+static void updateMap(unsigned char map, unsigned char tile_data_region) {
+	unsigned char * pixels;
+	unsigned short tile;
+	
+	if(map_region[map] != tile_data_region) {
+		memset(map_dirty[map], 1, sizeof(map_dirty[map]));
+		map_region[map] = tile_data_region;
+		map_changed[map] = 1;
+	}
+	
+	// Changed tile data dirties every map entry showing that tile
+	if(tiles_changed) {
+		for(int m = 0; m < 2; m++) {
+			for(int entry = 0; entry < LCD_MAP_ENTRIES; entry++) {
+				if(tile_dirty[mapTile(m, entry)]) {
+					map_dirty[m][entry] = 1;
+					map_changed[m] = 1;
+				}
 			}
+		}
+		memset(tile_dirty, 0, sizeof(tile_dirty));
+		tiles_changed = 0;
+	}
+	
+	if(!map_changed[map])
+		return;
+	for(int entry = 0; entry < LCD_MAP_ENTRIES; entry++) {
+		if(!map_dirty[map][entry])
+			continue;
+		
+		pixels = &map_pixels[map][(entry / 32) * 8][(entry % 32) * 8];
+		tile = mapTile(map, entry);
+		for(int row = 0; row < 8; row++)
+			memcpy(pixels + row * 256, tileRow(tile, row), 8);
+		map_dirty[map][entry] = 0;
+		map_versions[map][entry / 32]++;
+	}
+	map_changed[map] = 0;
+}
+
+/**
+	Tile (numbered from $8000) shown by a map entry, 0x8800 addressing
+	uses signed IDs around tile 256
+*/
+static unsigned short mapTile(unsigned char map, unsigned short entry) {
+	unsigned char tileID;
+	
+	tileID = vram[0x1800 + map * LCD_MAP_ENTRIES + entry];
+	return map_region[map] ? tileID : 256 + (signed char)tileID;
+}
+
+/**
+	Color numbers (0-3) of one row of a tile, tiles are numbered from
+	$8000. Rows are decoded when the two bytes behind them differ from
+	the ones they were decoded from, all zero until then.
+*/
+static const unsigned char * tileRow(unsigned short tile, unsigned char row) {
+	const unsigned char * data;
+	unsigned char * pixels;
+	unsigned short raw;
+	
+	data = (unsigned char *)vram + tile * LCD_TILE_SIZE + row * 2;
+	raw = data[0] | data[1] << 8;
+	pixels = tile_rows[tile][row];
+	if(raw != tile_raw[tile][row]) {
+		for(int i = 0; i < 8; i++)
+			pixels[i] = ((data[0] >> (7 - i)) & 0x1) | ((data[1] >> (7 - i)) & 0x1) << 1;
+		tile_raw[tile][row] = raw;
+	}
+	
+	return pixels;
+}
+
+/**
+	The first sprite in the line's list with a non transparent pixel
+	owns it, BG colors 1-3 still cover it if it is behind the BG
+*/
+static void drawSprites(const struct lcd_registers * regs, unsigned int * line, const unsigned char * bg_colors) {
+	unsigned char owned[LCD_SCREEN_WIDTH];
+	unsigned char palette, bits, n;
+	unsigned short row;
+	struct lcd_sprite * sprite;
+	const unsigned char * pixels;
+	int x, pixel;
+	
+	// The lists are brought up to date before the signature
+	if(!sprite_counts[regs->lcdc_y])
+		return;
+	
+	memset(owned, 0, sizeof(owned));
+	for(n = 0; n < sprite_counts[regs->lcdc_y]; n++) {
+		sprite = &oam[sprite_lines[regs->lcdc_y][n]];
+		palette = (sprite->flags & SPRITE_OBP1) ? regs->obp1 : regs->obp0;
+		
+		row = spriteRow(sprite, regs->lcdc_y, sprite_height);
+		pixels = tileRow(row / 8, row & 7);
+		
+		for(x = 0; x < 8; x++) {
+			pixel = sprite->x - 8 + x;
+			if(pixel < 0 || pixel >= LCD_SCREEN_WIDTH || owned[pixel])
+				continue;
 			
-			// Get the tile (16 bytes long)
-			tile = vram + vram_offset;
-			
-			// Get the current line in the tile
-			tile_line = ((lcd_registers->lcdc_y + lcd_registers->scroll_y) & 7) * 2;
-			tile += tile_line;
-			
-			// Probably a better way to do this, but it works for now
-			i = (7 - pixel) & 0x7;
-			bits = (tile[0] >> i) & 0x1;
-			bits |= ((tile[1] >> i) & 0x1) << 1;
-			
-			// Determine color from palete
-			// Gameboy Original
-			switch((lcd_registers->bgp >> ((bits * 2))) & 0x3)
-			{
-				case 0x0:
-					graphics_setColor(255, 255, 255, 255);
-					break;
-				case 0x1:
-					graphics_setColor(170, 170, 170, 255);
-					break;
-				case 0x2:
-					graphics_setColor(85, 85, 85, 255);
-					break;
-				case 0x3:
-					graphics_setColor(0, 0, 0, 255);
-					break;
-			}
+			bits = pixels[(sprite->flags & SPRITE_FLIP_X) ? 7 - x : x];
+			if(!bits)
+				continue;
 			
-			graphics_drawPixel(pixel, lcd_registers->lcdc_y);
+			owned[pixel] = 1;
+			if(!(sprite->flags & SPRITE_BEHIND_BG) || !bg_colors[pixel])
+				line[pixel] = shades[(palette >> (bits * 2)) & 0x3];
 		}
-		if(lcd_registers->lcdc_control & 0x2) {
-			// OBJ (Sprite) Display Enabled
+	}
+}
+
+/**
+	Row of the tiles ($8000) a sprite shows on line y, as tile * 8 + row
+*/
+static unsigned short spriteRow(const struct lcd_sprite * sprite, unsigned char y, unsigned char height) {
+	unsigned char row;
+	
+	row = y + 16 - sprite->y;
+	if(sprite->flags & SPRITE_FLIP_Y)
+		row = height - 1 - row;
+	
+	// 8x16 sprites ignore bit 0 of the tile
+	return ((height == 16 ? sprite->tile & 0xFE : sprite->tile) + row / 8) * 8 + (row & 7);
+}
+
+/**
+	Up to LCD_SPRITES_PER_LINE sprites per line, the first ones in OAM
+	are picked. Each list is sorted by X, OAM order breaks ties.
+*/
+static void buildSpriteLists(unsigned char height) {
+	struct lcd_sprite * sprite;
+	unsigned char * list, count;
+	int i, y, first, last, j;
+	
+	memset(sprite_counts, 0, sizeof(sprite_counts));
+	for(i = 0; i < LCD_SPRITES; i++) {
+		sprite = &oam[i];
+		first = sprite->y - 16;
+		last = first + height;
+		if(first < 0)
+			first = 0;
+		if(last > LCD_SCREEN_HEIGHT)
+			last = LCD_SCREEN_HEIGHT;
+		
+		for(y = first; y < last; y++) {
+			list = sprite_lines[y];
+			count = sprite_counts[y];
+			if(count == LCD_SPRITES_PER_LINE)
+				continue;
+			
+			// Insertion sort, equal X keeps OAM order
+			for(j = count; j > 0 && oam[list[j - 1]].x > sprite->x; j--)
+				list[j] = list[j - 1];
+			list[j] = i;
+			sprite_counts[y] = count + 1;
 		}
 	}
 	
-	graphics_render();
+	sprite_height = height;
+	oam_changed = 0;
+}
+
+static void logEntry(unsigned char address, unsigned char value) {
+	struct lcd_log_entry * entry;
+	
+	if(lcd_log_length == LCD_LOG_SIZE)
+		replayLog();
+	
+	entry = &lcd_log[lcd_log_length++];
+	entry->address = address;
+	entry->value = value;
+}
+
+/**
+	Draw the logged lines in order, applying the register writes
+	between them to replay_registers
+*/
+static void replayLog() {
+	struct lcd_log_entry * entry;
+	unsigned int i;
+	
+	PHASE_BEGIN(PHASE_SCANLINE);
+	for(i = 0; i < lcd_log_length; i++) {
+		entry = &lcd_log[i];
+		if(entry->address == LCD_LOG_LINE) {
+			replay_registers.lcdc_y = entry->value;
+			drawScanline(&replay_registers);
+		} else {
+			((unsigned char *)&replay_registers)[entry->address - 0x40] = entry->value;
+		}
+	}
+	PHASE_END();
+	lcd_log_length = 0;
 }
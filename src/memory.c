@@ -2,6 +2,7 @@
 #include "cpu.h"
 #include "lcd.h"
 #include "ioports.h"
+#include "joypad.h"
 
 /**
 Static Functions
@@ -14,6 +15,16 @@ static unsigned short io_port_read16(unsigned short address);
 static void io_port_write8(unsigned short address, char val);
 static void io_port_write16(unsigned short address, short val);
 
+static unsigned char  oam_read8(unsigned short address);
+static unsigned short oam_read16(unsigned short address);
+static void oam_write8(unsigned short address, char val);
+static void oam_write16(unsigned short address, short val);
+
+static unsigned char  vram_read8(unsigned short address);
+static unsigned short vram_read16(unsigned short address);
+static void vram_write8(unsigned short address, char val);
+static void vram_write16(unsigned short address, short val);
+
 /**
 Static Variables
 */
@@ -50,13 +61,26 @@ static const char bootstrap_code[256] = {
 
 	NOTE: FIND WAY TO SAVE LOCKED REGIONS
 */
-#define MEMORY_REGIONS_LEN 1
+#define MEMORY_REGIONS_LEN 3
+#define MEMORY_VRAM_REGION 2
 static struct memory_region memory_regions[MEMORY_REGIONS_LEN] = {
 	// IO PORTS
 	{
 		.base=0xFF00, .bound=0xFF4C,
 		.read8=&io_port_read8, .read16=&io_port_read16,
 		.write8=&io_port_write8, .write16=&io_port_write16
+	},
+	// OAM, the LCD keeps sprite lists built from it
+	{
+		.base=0xFE00, .bound=0xFEA0,
+		.read8=&oam_read8, .read16=&oam_read16,
+		.write8=&oam_write8, .write16=&oam_write16
+	},
+	// VRAM, the LCD keeps bitmaps of the BG maps drawn from it
+	{
+		.base=0x8000, .bound=0xA000,
+		.read8=&vram_read8, .read16=&vram_read16,
+		.write8=&vram_write8, .write16=&vram_write16
 	}
 };
 #define MEMORY_LOCKED_REGIONS_LEN 1
@@ -80,6 +104,7 @@ void memory_init() {
 void memory_reset() {
 	memset(memory, 0, INTERNAL_MEMORY_SIZE);
 	memcpy(memory, bootstrap_code, 256);
+	lcd_vramChanged(0x8000, 0x2000);
 }
 void * memory_dump() {
 	return memory;
@@ -89,6 +114,59 @@ void memory_lockRegion(enum memory_lock_regions region, enum memory_op op) {
 	memory_locked_regions[region].rwe_lock = op;
 }
 
+/**
+	Bulk access used by the CPU for recognized copy and fill loops
+	Only plain RAM qualifies: anything with a handler, a lock or
+	cartridge (MBC) side effects must go through read8/write8
+*/
+char memory_isPlain(unsigned short address, unsigned int len, enum memory_op op) {
+	unsigned int bound;
+	
+	// Also keeps the IE register ($FFFF) out
+	bound = address + len;
+	if(!len || bound > INTERNAL_MEMORY_SIZE)
+		return 0;
+	
+	// ROM can be read directly, but writes are MBC commands
+	if(address < 0x8000 && (op & MEMORY_WRITE))
+		return 0;
+	
+	// Echo RAM, OAM, unusable memory and I/O ports
+	if(bound > 0xE000 && address < 0xFF80)
+		return 0;
+	
+	// VRAM handlers only tell the LCD what changed, memory_fill and
+	// memory_copy do that for the whole range
+	for(int i = MEMORY_REGIONS_LEN; i--;) {
+		if(i != MEMORY_VRAM_REGION && address < memory_regions[i].bound && bound > memory_regions[i].base)
+			return 0;
+	}
+	for(int i = MEMORY_LOCKED_REGIONS_LEN; i--;) {
+		if(memory_locked_regions[i].rwe_lock & 0x1 &&
+			memory_locked_regions[i].rwe_lock & op &&
+			address < memory_locked_regions[i].bound &&
+			bound > memory_locked_regions[i].base) {
+			return 0;
+		}
+	}
+	
+	return 1;
+}
+void memory_fill(unsigned short address, unsigned char val, unsigned int len) {
+#ifdef DEBUG_MEMORY
+	printf("[memory_fill] Address: $%04x\tLength: %u\tValue: $%02x\n", address, len, val);
+#endif
+	memset(memory + address, val, len);
+	lcd_vramChanged(address, len);
+}
+void memory_copy(unsigned short dst, unsigned short src, unsigned int len) {
+#ifdef DEBUG_MEMORY
+	printf("[memory_copy] Address: $%04x\tSource: $%04x\tLength: %u\n", dst, src, len);
+#endif
+	memcpy(memory + dst, memory + src, len);
+	lcd_vramChanged(dst, len);
+}
+
 unsigned char memory_read8(unsigned short address) {
 	struct memory_region * region;
 #ifdef DEBUG_MEMORY
@@ -177,18 +255,66 @@ static char isRegionLocked(unsigned short address, enum memory_op op) {
 }
 
 static unsigned char io_port_read8(unsigned short address) {
+	// Joypad, buttons are sampled right now
+	if(address == 0xFF00) return joypad_read();
+	
 	return memory[address];
 }
 static unsigned short io_port_read16(unsigned short address) {
+	if(address == 0xFF00)
+		return io_port_read8(address) | io_port_read8(address + 1) << 8;
 	return *((short*)(memory + address));
 }
 static void io_port_write8(unsigned short address, char val) {	
+	// The LCD runs behind the CPU
+	if(address == 0xFF40) {
+		lcd_writeControl(val);
+		return;
+	}
+	
 	memory[address] = val;
 	
 	// Do we need to do a DMA Transfer
 	if(address == 0xFF46) lcd_dma_transfer(val);
+	
+	// Raster effects for deferred rendering
+	if(lcd_deferred) lcd_logWrite(address, val);
 }
 static void io_port_write16(unsigned short address, short val) {
+	if(address >= 0xFF3F && address < 0xFF4C) {
+		io_port_write8(address, val);
+		io_port_write8(address + 1, val >> 8);
+		return;
+	}
+	*(short*)(memory+address) = val;
+}
+
+static unsigned char oam_read8(unsigned short address) {
+	return memory[address];
+}
+static unsigned short oam_read16(unsigned short address) {
+	return *((short*)(memory + address));
+}
+static void oam_write8(unsigned short address, char val) {
+	memory[address] = val;
+	lcd_oamChanged();
+}
+static void oam_write16(unsigned short address, short val) {
 	*(short*)(memory+address) = val;
+	lcd_oamChanged();
 }
 
+static unsigned char vram_read8(unsigned short address) {
+	return memory[address];
+}
+static unsigned short vram_read16(unsigned short address) {
+	return *((short*)(memory + address));
+}
+static void vram_write8(unsigned short address, char val) {
+	memory[address] = val;
+	lcd_vramChanged(address, 1);
+}
+static void vram_write16(unsigned short address, short val) {
+	*(short*)(memory+address) = val;
+	lcd_vramChanged(address, 2);
+}
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <string.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "perf.h"
+#include "cpu.h"
+
+/**
+Global variables
+*/
+char perf_enabled;
+
+#ifdef __linux__
+/**
+Static Functions
+*/
+static int perf_open_counter(unsigned int type, unsigned long long config);
+static unsigned long long perf_read(int fd);
+
+/**
+Static Variables
+*/
+static const char * counter_names[PERF_COUNTERS] = {
+	"cycles", "instructions", "branch-misses", "L1i misses", "L1d misses"
+};
+
+static const unsigned int counter_types[PERF_COUNTERS] = {
+	PERF_TYPE_HARDWARE,
+	PERF_TYPE_HARDWARE,
+	PERF_TYPE_HARDWARE,
+	PERF_TYPE_HW_CACHE,
+	PERF_TYPE_HW_CACHE
+};
+
+static const unsigned long long counter_configs[PERF_COUNTERS] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_BRANCH_MISSES,
+	PERF_COUNT_HW_CACHE_L1I | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+	PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+};
+
+static int counter_fds[PERF_COUNTERS];
+
+// Guest progress when counting started
+static unsigned long long start_frames, start_instructions, start_cycles;
+
+// Host cycles per frame, from V_BLANK to V_BLANK
+static unsigned long long frame_cycles, frame_min, frame_max;
+#endif
+
+/**
+Functions
+*/
+int perf_open() {
+#ifdef __linux__
+	int i;
+	
+	for(i = 0; i < PERF_COUNTERS; i++) {
+		counter_fds[i] = perf_open_counter(counter_types[i], counter_configs[i]);
+		if(counter_fds[i] < 0)
+			printf("[perf_open] %s not available\n", counter_names[i]);
+	}
+	
+	// Everything else is reported relative to cycles
+	if(counter_fds[PERF_CYCLES] < 0) {
+		for(i = 0; i < PERF_COUNTERS; i++) {
+			if(counter_fds[i] >= 0)
+				close(counter_fds[i]);
+		}
+		return 0;
+	}
+	
+	frame_min = ~0ULL;
+	frame_max = 0;
+	perf_enabled = 1;
+	return 1;
+#else
+	printf("[perf_open] Hardware counters need Linux\n");
+	return 0;
+#endif
+}
+
+void perf_start() {
+#ifdef __linux__
+	int i;
+	
+	if(!perf_enabled)
+		return;
+	
+	start_frames = cpu_state.total_frames;
+	start_instructions = cpu_state.total_instructions;
+	start_cycles = cpu_state.total_cycles;
+	frame_cycles = 0;
+	
+	for(i = 0; i < PERF_COUNTERS; i++) {
+		if(counter_fds[i] >= 0)
+			ioctl(counter_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+}
+
+void perf_stop() {
+#ifdef __linux__
+	int i;
+	
+	if(!perf_enabled)
+		return;
+	
+	for(i = 0; i < PERF_COUNTERS; i++) {
+		if(counter_fds[i] >= 0)
+			ioctl(counter_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+	}
+#endif
+}
+
+/**
+	Called on V_BLANK entry to track the spread of host cycles per frame
+*/
+void perf_frame() {
+#ifdef __linux__
+	unsigned long long cycles, frame;
+	
+	cycles = perf_read(counter_fds[PERF_CYCLES]);
+	frame = cycles - frame_cycles;
+	frame_cycles = cycles;
+	
+	// The first frame started somewhere in the middle
+	if(cpu_state.total_frames - start_frames < 2)
+		return;
+	
+	if(frame < frame_min) frame_min = frame;
+	if(frame > frame_max) frame_max = frame;
+#endif
+}
+
+void perf_report(FILE * fp) {
+#ifdef __linux__
+	unsigned long long values[PERF_COUNTERS];
+	unsigned long long frames, instructions, cycles;
+	int i;
+	
+	if(!perf_enabled)
+		return;
+	
+	for(i = 0; i < PERF_COUNTERS; i++)
+		values[i] = counter_fds[i] >= 0 ? perf_read(counter_fds[i]) : 0;
+	
+	frames = cpu_state.total_frames - start_frames;
+	instructions = cpu_state.total_instructions - start_instructions;
+	cycles = cpu_state.total_cycles - start_cycles;
+	
+	fprintf(fp, "[perf] %llu guest frames, %llu guest instructions, %llu guest cycles\n",
+		frames, instructions, cycles);
+	fprintf(fp, "%-16s %16s %14s %14s\n", "Counter", "Total", "Per frame", "Per instr");
+	for(i = 0; i < PERF_COUNTERS; i++) {
+		if(counter_fds[i] < 0)
+			continue;
+		fprintf(fp, "%-16s %16llu %14.1f %14.2f\n",
+			counter_names[i],
+			values[i],
+			frames ? (double)values[i] / frames : 0.0,
+			instructions ? (double)values[i] / instructions : 0.0
+		);
+	}
+	
+	if(counter_fds[PERF_INSTRUCTIONS] >= 0 && values[PERF_CYCLES]) {
+		fprintf(fp, "IPC %.2f", (double)values[PERF_INSTRUCTIONS] / values[PERF_CYCLES]);
+		if(counter_fds[PERF_BRANCH_MISSES] >= 0 && values[PERF_INSTRUCTIONS])
+			fprintf(fp, ", %.2f branch misses per 1000 host instructions",
+				1000.0 * values[PERF_BRANCH_MISSES] / values[PERF_INSTRUCTIONS]);
+		fprintf(fp, "\n");
+	}
+	if(frame_max)
+		fprintf(fp, "Host cycles per frame: min %llu, max %llu\n", frame_min, frame_max);
+	fprintf(fp, "\n");
+	
+	for(i = 0; i < PERF_COUNTERS; i++) {
+		if(counter_fds[i] >= 0)
+			close(counter_fds[i]);
+	}
+	perf_enabled = 0;
+#endif
+}
+
+#ifdef __linux__
+/**
+Static Functions
+*/
+static int perf_open_counter(unsigned int type, unsigned long long config) {
+	struct perf_event_attr attr;
+	
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	
+	// Counters are multiplexed when there are more than the PMU has
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/**
+	Counter value, scaled up when it was only counting part of the time
+*/
+static unsigned long long perf_read(int fd) {
+	unsigned long long data[3];
+	
+	if(read(fd, data, sizeof(data)) != sizeof(data) || !data[2])
+		return 0;
+	if(data[1] == data[2])
+		return data[0];
+	return (unsigned long long)((double)data[0] * data[1] / data[2]);
+}
+#endif
@@ -0,0 +1,845 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(PROFILE_PHASES) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+#include "profiler.h"
+#include "cpu.h"
+#include "rom.h"
+#include "disasm.h"
+
+/**
+RGBDS .sym entry
+*/
+struct profiler_symbol {
+	unsigned short bank;
+	unsigned short address;
+	char name[64];
+};
+
+struct profiler_hotspot {
+	unsigned short bank;
+	unsigned short address;
+	unsigned long long samples;
+};
+
+/**
+Call tree node, one per distinct call path
+Inclusive cycles are derived from the children when reporting
+*/
+struct profiler_node {
+	unsigned short bank;
+	unsigned short address;
+	char root;
+	unsigned int parent;
+	unsigned int child;
+	unsigned int sibling;
+	unsigned long long calls;
+	unsigned long long self_cycles;
+	unsigned long long total_cycles;
+};
+
+/**
+Shadow call stack entry
+sp points at the pushed return address
+*/
+struct profiler_frame {
+	unsigned int node;
+	unsigned short sp;
+};
+
+/**
+Call graph totals of one guest function
+*/
+struct profiler_function {
+	unsigned int node;
+	unsigned long long calls;
+	unsigned long long inclusive;
+	unsigned long long exclusive;
+};
+
+enum profiler_root {
+	PROFILER_NOT_ROOT = 0,
+	PROFILER_MAIN_ROOT,
+	PROFILER_INTERRUPT_ROOT
+};
+
+#define PROFILER_NO_NODE 0xFFFFFFFF
+
+/**
+Static Functions
+*/
+static struct profiler_symbol * findSymbol(unsigned short bank, unsigned short address);
+static int compareSymbols(const void * a, const void * b);
+static int compareHotspots(const void * a, const void * b);
+static void addHotspot(unsigned short bank, unsigned short address, unsigned long long samples);
+static void printLocation(FILE * fp, unsigned short bank, unsigned short address);
+
+static unsigned short getBank(unsigned short address);
+static unsigned int addNode(unsigned int parent, unsigned short address, char root);
+static unsigned int findChild(unsigned int parent, unsigned short address);
+static void chargeCycles();
+static void nodeName(unsigned int node, char * buf);
+static void writeCollapsed(FILE * fp, unsigned int node, char * path, unsigned int length);
+static void reportCallgraph(FILE * fp);
+static int compareFunctions(const void * a, const void * b);
+static int compareInclusive(const void * a, const void * b);
+
+#ifdef PROFILE_OPCODES
+static void reportOpcodes(FILE * fp);
+static int compareOpcodes(const void * a, const void * b);
+#endif
+
+#ifdef PROFILE_PHASES
+static unsigned long long readTicks();
+static unsigned long long readNanoseconds();
+static double ticksPerMicrosecond();
+static void chargePhase();
+static void reportPhases(FILE * fp);
+#endif
+
+/**
+Global variables
+*/
+unsigned long long profiler_next_sample = ~0ULL;
+char profiler_callgraph;
+
+#ifdef PROFILE_OPCODES
+struct profiler_opcode profiler_opcodes[0x200];
+#endif
+
+/**
+Static Variables
+*/
+static unsigned int sample_interval;
+static unsigned long long total_samples;
+
+// Everything outside of $4000-$7FFF, indexed by PC
+static unsigned int * samples;
+// $4000-$7FFF per ROM bank, allocated on first use
+static unsigned int * banked_samples[PROFILER_MAX_BANKS];
+
+static struct profiler_symbol * symbols;
+static unsigned int number_symbols;
+
+static struct profiler_hotspot * hotspots;
+static unsigned int number_hotspots;
+
+static char * callgraph_filename;
+static struct profiler_node * nodes;
+static unsigned int number_nodes;
+// Node 0 is the main program, these are roots of their own
+static unsigned int interrupt_roots[5];
+
+static struct profiler_frame call_stack[PROFILER_STACK_DEPTH];
+static unsigned int call_depth;
+static unsigned long long charged_cycles;
+
+#ifdef PROFILE_PHASES
+static const char * phase_names[PHASE_COUNT] = {
+	"cpu", "lcd_update", "drawScanline", "graphics_render", "events", "interrupts"
+};
+
+static enum profiler_phase phase_stack[PROFILER_PHASE_DEPTH];
+static unsigned int phase_depth;
+static unsigned long long phase_mark;
+
+// Ticks per phase for the running frame, the last second and overall
+static unsigned long long phase_frame[PHASE_COUNT];
+static unsigned long long phase_second[PHASE_COUNT];
+static unsigned long long phase_total[PHASE_COUNT];
+
+static unsigned long long frames_second, frames_total;
+static unsigned long long frame_max_second, frame_max_total;
+
+// Ticks and wall clock when timing started, used to calibrate the TSC
+static unsigned long long start_ticks, start_nanoseconds;
+static unsigned long long second_nanoseconds;
+#endif
+
+/**
+Functions
+*/
+void profiler_init(unsigned int interval) {
+	if(!interval)
+		return;
+	
+	samples = calloc(0x10000, sizeof(unsigned int));
+	if(!samples) {
+		printf("[profiler_init] Malloc failed\n");
+		return;
+	}
+	
+	sample_interval = interval;
+	profiler_next_sample = cpu_state.total_cycles + interval;
+}
+
+void profiler_loadSymbols(char * filename) {
+	unsigned int bank, address;
+	char line[256], name[64];
+	FILE * fp;
+	
+	fp = fopen(filename, "r");
+	if(!fp) {
+		printf("[profiler_loadSymbols] Cannot open %s\n", filename);
+		return;
+	}
+	
+	if(!symbols)
+		symbols = malloc(PROFILER_MAX_SYMBOLS * sizeof(struct profiler_symbol));
+	
+	// "BB:AAAA Label", comments start with ';'
+	while(number_symbols < PROFILER_MAX_SYMBOLS && fgets(line, sizeof(line), fp)) {
+		if(sscanf(line, "%x:%x %63s", &bank, &address, name) != 3)
+			continue;
+		
+		symbols[number_symbols].bank = bank;
+		symbols[number_symbols].address = address;
+		strcpy(symbols[number_symbols].name, name);
+		number_symbols++;
+	}
+	fclose(fp);
+	
+	qsort(symbols, number_symbols, sizeof(struct profiler_symbol), compareSymbols);
+}
+
+/**
+	Called once total_cycles passes profiler_next_sample
+	Long instructions (and collapsed loops) can cover several samples
+*/
+void profiler_sample(unsigned short pc) {
+	unsigned long long count;
+	unsigned short bank;
+	
+	count = (cpu_state.total_cycles - profiler_next_sample) / sample_interval + 1;
+	profiler_next_sample += count * sample_interval;
+	total_samples += count;
+	
+	if(pc < 0x4000 || pc >= 0x8000) {
+		samples[pc] += count;
+		return;
+	}
+	
+	bank = rom_get_bank() % PROFILER_MAX_BANKS;
+	if(!banked_samples[bank]) {
+		banked_samples[bank] = calloc(0x4000, sizeof(unsigned int));
+		if(!banked_samples[bank])
+			return;
+	}
+	banked_samples[bank][pc - 0x4000] += count;
+}
+
+void profiler_report(FILE * fp) {
+	struct profiler_symbol * symbol;
+	unsigned long long * symbol_samples;
+	unsigned int i, b;
+	
+#ifdef PROFILE_OPCODES
+	reportOpcodes(fp);
+#endif
+#ifdef PROFILE_PHASES
+	reportPhases(fp);
+#endif
+	if(profiler_callgraph)
+		reportCallgraph(fp);
+	
+	if(!samples)
+		return;
+	
+	// Collect every address that was hit
+	number_hotspots = 0;
+	for(i = 0; i < 0x10000; i++)
+		number_hotspots += samples[i] != 0;
+	for(b = 0; b < PROFILER_MAX_BANKS; b++) {
+		for(i = 0; banked_samples[b] && i < 0x4000; i++)
+			number_hotspots += banked_samples[b][i] != 0;
+	}
+	hotspots = malloc((number_hotspots + 1) * sizeof(struct profiler_hotspot));
+	if(!hotspots)
+		return;
+	
+	number_hotspots = 0;
+	for(i = 0; i < 0x10000; i++) {
+		if(samples[i])
+			addHotspot(0, i, samples[i]);
+	}
+	for(b = 0; b < PROFILER_MAX_BANKS; b++) {
+		if(!banked_samples[b]) continue;
+		for(i = 0; i < 0x4000; i++) {
+			if(banked_samples[b][i])
+				addHotspot(b, 0x4000 + i, banked_samples[b][i]);
+		}
+	}
+	qsort(hotspots, number_hotspots, sizeof(struct profiler_hotspot), compareHotspots);
+	
+	fprintf(fp, "[profiler] %llu samples, one every %u cycles\n", total_samples, sample_interval);
+	fprintf(fp, "%10s %7s  %-7s  %s\n", "Samples", "%", "Address", "Symbol");
+	for(i = 0; i < number_hotspots && i < PROFILER_REPORT_SIZE; i++) {
+		fprintf(fp, "%10llu %6.2f%%  ",
+			hotspots[i].samples,
+			100.0 * hotspots[i].samples / total_samples
+		);
+		printLocation(fp, hotspots[i].bank, hotspots[i].address);
+	}
+	
+	// Roll addresses up into the symbols containing them
+	if(number_symbols) {
+		symbol_samples = calloc(number_symbols, sizeof(unsigned long long));
+		for(i = 0; i < number_hotspots; i++) {
+			symbol = findSymbol(hotspots[i].bank, hotspots[i].address);
+			if(symbol)
+				symbol_samples[symbol - symbols] += hotspots[i].samples;
+		}
+		
+		number_hotspots = 0;
+		for(i = 0; i < number_symbols; i++) {
+			if(symbol_samples[i])
+				addHotspot(symbols[i].bank, i, symbol_samples[i]);
+		}
+		qsort(hotspots, number_hotspots, sizeof(struct profiler_hotspot), compareHotspots);
+		
+		fprintf(fp, "\n%10s %7s  %s\n", "Samples", "%", "Symbol");
+		for(i = 0; i < number_hotspots && i < PROFILER_REPORT_SIZE; i++) {
+			fprintf(fp, "%10llu %6.2f%%  %s\n",
+				hotspots[i].samples,
+				100.0 * hotspots[i].samples / total_samples,
+				symbols[hotspots[i].address].name
+			);
+		}
+		free(symbol_samples);
+	}
+	
+	free(hotspots);
+}
+
+void profiler_initCallgraph(char * filename) {
+	unsigned int i;
+	
+	nodes = malloc(PROFILER_MAX_NODES * sizeof(struct profiler_node));
+	if(!nodes) {
+		printf("[profiler_initCallgraph] Malloc failed\n");
+		return;
+	}
+	
+	number_nodes = 0;
+	addNode(PROFILER_NO_NODE, 0, PROFILER_MAIN_ROOT);
+	for(i = 0; i < 5; i++)
+		interrupt_roots[i] = PROFILER_NO_NODE;
+	
+	callgraph_filename = filename;
+	call_depth = 0;
+	charged_cycles = cpu_state.total_cycles;
+	profiler_callgraph = 1;
+}
+
+/**
+	CALL and RST, after the return address was pushed
+*/
+void profiler_call(unsigned short address, unsigned short sp) {
+	unsigned int node;
+	
+	chargeCycles();
+	
+	// Frames whose return address was overwritten are gone
+	while(call_depth && call_stack[call_depth - 1].sp <= sp)
+		call_depth--;
+	
+	node = findChild(call_depth ? call_stack[call_depth - 1].node : 0, address);
+	nodes[node].calls++;
+	
+	// Too deep, the time stays with the deepest frame we have
+	if(call_depth < PROFILER_STACK_DEPTH) {
+		call_stack[call_depth].node = node;
+		call_stack[call_depth].sp = sp;
+		call_depth++;
+	}
+}
+
+/**
+	RET, RET cc and RETI, after the return address was popped
+	
+	Every frame whose return address is now above the stack pointer has
+	returned. This unwinds frames left behind by code that drops return
+	addresses or uses RET as a jump.
+*/
+void profiler_return(unsigned short sp) {
+	chargeCycles();
+	
+	while(call_depth && call_stack[call_depth - 1].sp < sp)
+		call_depth--;
+}
+
+/**
+	Interrupt dispatch, handlers get a root of their own
+*/
+void profiler_interrupt(unsigned short vector, unsigned short sp) {
+	unsigned int root;
+	
+	chargeCycles();
+	
+	while(call_depth && call_stack[call_depth - 1].sp <= sp)
+		call_depth--;
+	
+	root = (vector - 0x40) >> 3;
+	if(root >= 5)
+		return;
+	if(interrupt_roots[root] == PROFILER_NO_NODE)
+		interrupt_roots[root] = addNode(PROFILER_NO_NODE, vector, PROFILER_INTERRUPT_ROOT);
+	if(interrupt_roots[root] == PROFILER_NO_NODE)
+		return;
+	nodes[interrupt_roots[root]].calls++;
+	
+	if(call_depth < PROFILER_STACK_DEPTH) {
+		call_stack[call_depth].node = interrupt_roots[root];
+		call_stack[call_depth].sp = sp;
+		call_depth++;
+	}
+}
+
+#ifdef PROFILE_PHASES
+void profiler_phaseBegin(enum profiler_phase phase) {
+	if(!start_ticks) {
+		start_ticks = readTicks();
+		start_nanoseconds = readNanoseconds();
+		second_nanoseconds = start_nanoseconds;
+		phase_mark = start_ticks;
+	}
+	
+	chargePhase();
+	if(phase_depth < PROFILER_PHASE_DEPTH)
+		phase_stack[phase_depth] = phase;
+	phase_depth++;
+}
+
+void profiler_phaseEnd() {
+	chargePhase();
+	if(phase_depth)
+		phase_depth--;
+}
+
+/**
+	Called on V_BLANK entry, closes the running frame
+	Prints a summary of the last second once one has passed
+*/
+void profiler_phaseFrame() {
+	unsigned long long frame, now;
+	double ticks;
+	int i;
+	
+	chargePhase();
+	
+	frame = 0;
+	for(i = 0; i < PHASE_COUNT; i++) {
+		frame += phase_frame[i];
+		phase_second[i] += phase_frame[i];
+		phase_total[i] += phase_frame[i];
+		phase_frame[i] = 0;
+	}
+	if(frame > frame_max_second) frame_max_second = frame;
+	if(frame > frame_max_total) frame_max_total = frame;
+	frames_second++;
+	frames_total++;
+	
+	now = readNanoseconds();
+	if(now - second_nanoseconds < 1000000000ULL)
+		return;
+	
+	ticks = ticksPerMicrosecond();
+	printf("[phases] %llu frames, max %.0fus, avg us/frame:", frames_second, frame_max_second / ticks);
+	for(i = 0; i < PHASE_COUNT; i++) {
+		printf(" %s %.1f", phase_names[i], phase_second[i] / ticks / frames_second);
+		phase_second[i] = 0;
+	}
+	printf("\n");
+	
+	frames_second = 0;
+	frame_max_second = 0;
+	second_nanoseconds = now;
+}
+#endif
+
+/**
+Static Functions
+*/
+static void addHotspot(unsigned short bank, unsigned short address, unsigned long long count) {
+	hotspots[number_hotspots].bank = bank;
+	hotspots[number_hotspots].address = address;
+	hotspots[number_hotspots].samples = count;
+	number_hotspots++;
+}
+
+/**
+	Closest symbol at or before the address in the same bank
+*/
+static struct profiler_symbol * findSymbol(unsigned short bank, unsigned short address) {
+	int low, high, mid;
+	struct profiler_symbol * found;
+	
+	found = NULL;
+	low = 0;
+	high = number_symbols - 1;
+	while(low <= high) {
+		mid = (low + high) / 2;
+		if(symbols[mid].bank < bank ||
+			(symbols[mid].bank == bank && symbols[mid].address <= address)) {
+			if(symbols[mid].bank == bank)
+				found = &symbols[mid];
+			low = mid + 1;
+		} else {
+			high = mid - 1;
+		}
+	}
+	return found;
+}
+
+static void printLocation(FILE * fp, unsigned short bank, unsigned short address) {
+	struct profiler_symbol * symbol;
+	
+	fprintf(fp, "%02x:%04x  ", bank, address);
+	symbol = findSymbol(bank, address);
+	if(!symbol)
+		fprintf(fp, "\n");
+	else if(symbol->address == address)
+		fprintf(fp, "%s\n", symbol->name);
+	else
+		fprintf(fp, "%s+$%x\n", symbol->name, address - symbol->address);
+}
+
+static int compareSymbols(const void * a, const void * b) {
+	const struct profiler_symbol * x = a, * y = b;
+	
+	if(x->bank != y->bank) return x->bank - y->bank;
+	return x->address - y->address;
+}
+static int compareHotspots(const void * a, const void * b) {
+	const struct profiler_hotspot * x = a, * y = b;
+	
+	if(x->samples == y->samples) return 0;
+	return x->samples < y->samples ? 1 : -1;
+}
+
+static unsigned short getBank(unsigned short address) {
+	if(address >= 0x4000 && address < 0x8000)
+		return rom_get_bank();
+	return 0;
+}
+
+static unsigned int addNode(unsigned int parent, unsigned short address, char root) {
+	struct profiler_node * node;
+	
+	if(number_nodes >= PROFILER_MAX_NODES)
+		return PROFILER_NO_NODE;
+	
+	node = &nodes[number_nodes];
+	node->bank = getBank(address);
+	node->address = address;
+	node->root = root;
+	node->parent = parent;
+	node->child = PROFILER_NO_NODE;
+	node->sibling = PROFILER_NO_NODE;
+	node->calls = 0;
+	node->self_cycles = 0;
+	node->total_cycles = 0;
+	
+	if(parent != PROFILER_NO_NODE) {
+		node->sibling = nodes[parent].child;
+		nodes[parent].child = number_nodes;
+	}
+	
+	return number_nodes++;
+}
+
+/**
+	Node for a call to address from parent, created on first use
+	Falls back to the parent once the tree is full
+*/
+static unsigned int findChild(unsigned int parent, unsigned short address) {
+	unsigned int node;
+	unsigned short bank;
+	
+	bank = getBank(address);
+	for(node = nodes[parent].child; node != PROFILER_NO_NODE; node = nodes[node].sibling) {
+		if(nodes[node].address == address && nodes[node].bank == bank)
+			return node;
+	}
+	
+	node = addNode(parent, address, PROFILER_NOT_ROOT);
+	return node == PROFILER_NO_NODE ? parent : node;
+}
+
+/**
+	Give the cycles since the last call graph event to the running function
+*/
+static void chargeCycles() {
+	unsigned int node;
+	
+	node = call_depth ? call_stack[call_depth - 1].node : 0;
+	nodes[node].self_cycles += cpu_state.total_cycles - charged_cycles;
+	charged_cycles = cpu_state.total_cycles;
+}
+
+static void nodeName(unsigned int node, char * buf) {
+	struct profiler_symbol * symbol;
+	
+	if(nodes[node].root == PROFILER_MAIN_ROOT) {
+		strcpy(buf, "main");
+		return;
+	}
+	
+	symbol = findSymbol(nodes[node].bank, nodes[node].address);
+	if(symbol && symbol->address == nodes[node].address)
+		sprintf(buf, "%s", symbol->name);
+	else if(nodes[node].root == PROFILER_INTERRUPT_ROOT)
+		sprintf(buf, "int_%02x", nodes[node].address);
+	else if(symbol)
+		sprintf(buf, "%s+$%x", symbol->name, nodes[node].address - symbol->address);
+	else
+		sprintf(buf, "%02x:%04x", nodes[node].bank, nodes[node].address);
+}
+
+/**
+	One "root;caller;callee self_cycles" line per node with its own time
+*/
+static void writeCollapsed(FILE * fp, unsigned int node, char * path, unsigned int length) {
+	unsigned int child;
+	
+	if(length) path[length++] = ';';
+	nodeName(node, path + length);
+	length += strlen(path + length);
+	
+	if(nodes[node].self_cycles)
+		fprintf(fp, "%s %llu\n", path, nodes[node].self_cycles);
+	
+	for(child = nodes[node].child; child != PROFILER_NO_NODE; child = nodes[child].sibling)
+		writeCollapsed(fp, child, path, length);
+}
+
+static void reportCallgraph(FILE * fp) {
+	struct profiler_function * functions;
+	unsigned int i, j, parent, number_functions, * order;
+	char * path, name[80];
+	FILE * out;
+	
+	chargeCycles();
+	
+	// Children are always created after their parent
+	for(i = 0; i < number_nodes; i++)
+		nodes[i].total_cycles = nodes[i].self_cycles;
+	for(i = number_nodes - 1; i > 0; i--) {
+		if(nodes[i].parent != PROFILER_NO_NODE)
+			nodes[nodes[i].parent].total_cycles += nodes[i].total_cycles;
+	}
+	
+	path = malloc((PROFILER_STACK_DEPTH + 1) * sizeof(name));
+	out = fopen(callgraph_filename, "w");
+	if(!out || !path) {
+		printf("[profiler] Cannot write %s\n", callgraph_filename);
+	} else {
+		writeCollapsed(out, 0, path, 0);
+		for(i = 0; i < 5; i++) {
+			if(interrupt_roots[i] != PROFILER_NO_NODE)
+				writeCollapsed(out, interrupt_roots[i], path, 0);
+		}
+	}
+	if(out) fclose(out);
+	free(path);
+	
+	// Group the nodes of each function together
+	order = malloc(number_nodes * sizeof(unsigned int));
+	functions = malloc(number_nodes * sizeof(struct profiler_function));
+	if(!order || !functions) {
+		free(order);
+		free(functions);
+		return;
+	}
+	for(i = 0; i < number_nodes; i++)
+		order[i] = i;
+	qsort(order, number_nodes, sizeof(unsigned int), compareFunctions);
+	
+	number_functions = 0;
+	for(i = 0; i < number_nodes; i++) {
+		if(!i || compareFunctions(&order[i - 1], &order[i])) {
+			functions[number_functions].node = order[i];
+			functions[number_functions].calls = 0;
+			functions[number_functions].inclusive = 0;
+			functions[number_functions].exclusive = 0;
+			number_functions++;
+		}
+		functions[number_functions - 1].calls += nodes[order[i]].calls;
+		functions[number_functions - 1].exclusive += nodes[order[i]].self_cycles;
+		
+		// Recursive calls are already inside an outer inclusive time
+		for(parent = nodes[order[i]].parent; parent != PROFILER_NO_NODE; parent = nodes[parent].parent) {
+			if(!compareFunctions(&order[i], &parent))
+				break;
+		}
+		if(parent == PROFILER_NO_NODE)
+			functions[number_functions - 1].inclusive += nodes[order[i]].total_cycles;
+	}
+	qsort(functions, number_functions, sizeof(struct profiler_function), compareInclusive);
+	
+	fprintf(fp, "[profiler] Call graph written to %s, %u nodes\n", callgraph_filename, number_nodes);
+	fprintf(fp, "%14s %14s %10s  %s\n", "Inclusive", "Exclusive", "Calls", "Function");
+	for(j = 0; j < number_functions && j < PROFILER_REPORT_SIZE; j++) {
+		nodeName(functions[j].node, name);
+		fprintf(fp, "%14llu %14llu %10llu  %s\n",
+			functions[j].inclusive,
+			functions[j].exclusive,
+			functions[j].calls,
+			name
+		);
+	}
+	fprintf(fp, "\n");
+	
+	free(order);
+	free(functions);
+}
+
+static int compareFunctions(const void * a, const void * b) {
+	const struct profiler_node * x = &nodes[*(const unsigned int *)a];
+	const struct profiler_node * y = &nodes[*(const unsigned int *)b];
+	
+	if(x->root != y->root) return x->root - y->root;
+	if(x->bank != y->bank) return x->bank - y->bank;
+	return x->address - y->address;
+}
+static int compareInclusive(const void * a, const void * b) {
+	const struct profiler_function * x = a, * y = b;
+	
+	if(x->inclusive == y->inclusive) return 0;
+	return x->inclusive < y->inclusive ? 1 : -1;
+}
+
+#ifdef PROFILE_OPCODES
+/**
+	Instruction mix, most executed first
+	Prefixed opcodes are listed on their own instead of under $CB
+*/
+static void reportOpcodes(FILE * fp) {
+	unsigned short order[0x200];
+	unsigned long long instructions, cycles, running;
+	unsigned char bytes[3];
+	unsigned int i, number;
+	char name[DISASM_MAX_LENGTH];
+	
+	instructions = cycles = 0;
+	for(i = 0; i < 0x100; i++) {
+		instructions += profiler_opcodes[i].count;
+		cycles += profiler_opcodes[i].cycles;
+	}
+	if(!instructions)
+		return;
+	
+	number = 0;
+	for(i = 0; i < 0x200; i++) {
+		if(i != 0xCB && profiler_opcodes[i].count)
+			order[number++] = i;
+	}
+	qsort(order, number, sizeof(unsigned short), compareOpcodes);
+	
+	fprintf(fp, "[profiler] %llu instructions, %llu cycles, %u distinct opcodes\n", instructions, cycles, number);
+	fprintf(fp, "%-6s %-20s %14s %7s %14s %7s %7s\n", "Opcode", "Instruction", "Count", "%", "Cycles", "%", "Cum %");
+	running = 0;
+	for(i = 0; i < number; i++) {
+		bytes[0] = order[i] > 0xFF ? 0xCB : order[i];
+		bytes[1] = order[i] & 0xFF;
+		bytes[2] = 0;
+		disasm_mnemonic(bytes, name);
+		running += profiler_opcodes[order[i]].count;
+		
+		fprintf(fp, "%s%02X   %-20s %14llu %6.2f%% %14llu %6.2f%% %6.2f%%\n",
+			order[i] > 0xFF ? "CB" : "  ",
+			order[i] & 0xFF,
+			name,
+			profiler_opcodes[order[i]].count,
+			100.0 * profiler_opcodes[order[i]].count / instructions,
+			profiler_opcodes[order[i]].cycles,
+			100.0 * profiler_opcodes[order[i]].cycles / cycles,
+			100.0 * running / instructions
+		);
+	}
+	fprintf(fp, "\n");
+}
+
+static int compareOpcodes(const void * a, const void * b) {
+	const struct profiler_opcode * x = &profiler_opcodes[*(const unsigned short *)a];
+	const struct profiler_opcode * y = &profiler_opcodes[*(const unsigned short *)b];
+	
+	if(x->count == y->count) return 0;
+	return x->count < y->count ? 1 : -1;
+}
+#endif
+
+#ifdef PROFILE_PHASES
+static unsigned long long readTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return readNanoseconds();
+#endif
+}
+
+static unsigned long long readNanoseconds() {
+	struct timespec now;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+	TSC rate measured against the wall clock since timing started
+*/
+static double ticksPerMicrosecond() {
+	unsigned long long nanoseconds;
+	
+	nanoseconds = readNanoseconds() - start_nanoseconds;
+	if(!nanoseconds)
+		return 1.0;
+	return (readTicks() - start_ticks) * 1000.0 / nanoseconds;
+}
+
+/**
+	Give the ticks since the last phase change to the innermost phase
+*/
+static void chargePhase() {
+	unsigned long long now;
+	
+	now = readTicks();
+	if(phase_depth && phase_depth <= PROFILER_PHASE_DEPTH)
+		phase_frame[phase_stack[phase_depth - 1]] += now - phase_mark;
+	phase_mark = now;
+}
+
+static void reportPhases(FILE * fp) {
+	unsigned long long total;
+	double ticks;
+	int i;
+	
+	if(!frames_total)
+		return;
+	
+	ticks = ticksPerMicrosecond();
+	total = 0;
+	for(i = 0; i < PHASE_COUNT; i++)
+		total += phase_total[i];
+	
+	fprintf(fp, "[profiler] %llu frames, %.1fus per frame on average, %.1fus at most (%.0f ticks/us)\n",
+		frames_total,
+		total / ticks / frames_total,
+		frame_max_total / ticks,
+		ticks
+	);
+	fprintf(fp, "%-16s %12s %12s %7s\n", "Phase", "Total ms", "us/frame", "%");
+	for(i = 0; i < PHASE_COUNT; i++) {
+		fprintf(fp, "%-16s %12.1f %12.1f %6.2f%%\n",
+			phase_names[i],
+			phase_total[i] / ticks / 1000.0,
+			phase_total[i] / ticks / frames_total,
+			total ? 100.0 * phase_total[i] / total : 0.0
+		);
+	}
+	fprintf(fp, "\n");
+}
+#endif
@@ -31,3 +31,11 @@ void rom_load(char * filename) {
 void rom_set_preamble() {
 	memcpy(memory_dump(), preamble, 0x100);
 }
+
+/**
+	ROM bank mapped at $4000-$7FFF
+	There is no MBC support yet so this is always bank 1
+*/
+unsigned short rom_get_bank() {
+	return 1;
+}
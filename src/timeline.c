@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "timeline.h"
+#include "cpu.h"
+
+/**
+Static Functions
+*/
+static void timeline_thread_name(enum timeline_thread thread, const char * name);
+
+/**
+Global variables
+*/
+char timeline_enabled;
+
+/**
+Static Variables
+*/
+static FILE * timeline_file;
+static unsigned long long timeline_start;
+
+// Start of the running frame, scanline batch and V_BLANK
+static unsigned long long frame_start, batch_start, vblank_start;
+static unsigned char batch_line, current_line;
+
+/**
+Functions
+*/
+int timeline_open(char * filename) {
+	timeline_file = fopen(filename, "w");
+	if(!timeline_file) {
+		printf("[timeline_open] Cannot open %s\n", filename);
+		return 0;
+	}
+	
+	// Every event ends with a comma, timeline_close() adds a last one
+	// without. The viewers also accept a file cut short by a crash.
+	fprintf(timeline_file, "[\n");
+	timeline_thread_name(TIMELINE_EMULATOR, "emulator");
+	timeline_thread_name(TIMELINE_TRACE_WRITER, "trace writer");
+	timeline_thread_name(TIMELINE_RENDER, "render");
+	
+	timeline_start = 0;
+	timeline_start = timeline_now();
+	frame_start = batch_start = 0;
+	batch_line = current_line = 0;
+	timeline_enabled = 1;
+	
+	return 1;
+}
+
+void timeline_close() {
+	if(!timeline_enabled)
+		return;
+	timeline_enabled = 0;
+	
+	fprintf(timeline_file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"GameBoy\"}}\n]\n");
+	fclose(timeline_file);
+}
+
+/**
+	Host microseconds since timeline_open()
+*/
+unsigned long long timeline_now() {
+	struct timespec now;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000ULL + now.tv_nsec / 1000 - timeline_start;
+}
+
+/**
+	Complete event from start to end (timeline_now() values)
+	A single fprintf each, so other threads can add spans too
+*/
+void timeline_span(const char * name, const char * category,
+	unsigned long long start, unsigned long long end, enum timeline_thread thread) {
+	fprintf(timeline_file,
+		"{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":1,\"tid\":%d},\n",
+		name, category, start, end - start, thread
+	);
+}
+
+/**
+	LY moved to line during the visible part of the frame
+*/
+void timeline_line(unsigned char line) {
+	unsigned long long now;
+	char name[32];
+	
+	current_line = line;
+	if(line % TIMELINE_LINE_BATCH)
+		return;
+	
+	now = timeline_now();
+	sprintf(name, "lines %u-%u", batch_line, line - 1);
+	timeline_span(name, "ppu", batch_start, now, TIMELINE_EMULATOR);
+	batch_start = now;
+	batch_line = line;
+}
+
+/**
+	V_BLANK starts (entering) or ends, the frame ends with it
+*/
+void timeline_vblank(char entering) {
+	unsigned long long now;
+	char name[32];
+	
+	now = timeline_now();
+	if(entering) {
+		// Lines since the last full batch
+		if(current_line != batch_line) {
+			sprintf(name, "lines %u-%u", batch_line, current_line - 1);
+			timeline_span(name, "ppu", batch_start, now, TIMELINE_EMULATOR);
+		}
+		vblank_start = now;
+		return;
+	}
+	
+	timeline_span("vblank", "ppu", vblank_start, now, TIMELINE_EMULATOR);
+	
+	sprintf(name, "frame %llu", cpu_state.total_frames);
+	timeline_span(name, "frame", frame_start, now, TIMELINE_EMULATOR);
+	frame_start = batch_start = now;
+	batch_line = current_line = 0;
+}
+
+/**
+Static Functions
+*/
+static void timeline_thread_name(enum timeline_thread thread, const char * name) {
+	fprintf(timeline_file,
+		"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+		thread, name
+	);
+}
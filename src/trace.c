@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "trace.h"
+#include "timeline.h"
+
+/**
+Static Functions
+*/
+static int trace_writer(void * arg);
+
+/**
+Global variables
+*/
+struct trace_buffer trace_buffer;
+
+/**
+Static Variables
+*/
+static FILE * trace_fp;
+static SDL_Thread * writer_thread;
+static atomic_char writer_stop;
+static unsigned long long records_written;
+
+/**
+Functions
+*/
+int trace_open(char * filename) {
+	struct trace_file_header header;
+	
+	trace_fp = fopen(filename, "wb");
+	if(!trace_fp) {
+		printf("[trace_open] Cannot open %s\n", filename);
+		return 0;
+	}
+	
+	trace_buffer.records = malloc(TRACE_BUFFER_SIZE * sizeof(struct trace_record));
+	if(!trace_buffer.records) {
+		printf("[trace_open] Malloc failed\n");
+		fclose(trace_fp);
+		return 0;
+	}
+	
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+	header.version = TRACE_VERSION;
+	header.record_size = sizeof(struct trace_record);
+	fwrite(&header, sizeof(header), 1, trace_fp);
+	
+	atomic_store(&trace_buffer.head, 0);
+	atomic_store(&trace_buffer.tail, 0);
+	trace_buffer.limit = TRACE_BUFFER_SIZE;
+	trace_buffer.stalls = 0;
+	records_written = 0;
+	
+	atomic_store(&writer_stop, 0);
+	writer_thread = SDL_CreateThread(trace_writer, "trace", NULL);
+	
+	trace_buffer.enabled = 1;
+	return 1;
+}
+
+void trace_close() {
+	if(!trace_buffer.enabled)
+		return;
+	trace_buffer.enabled = 0;
+	
+	// Writer drains whatever is left before exiting
+	atomic_store(&writer_stop, 1);
+	SDL_WaitThread(writer_thread, NULL);
+	
+	fclose(trace_fp);
+	free(trace_buffer.records);
+	trace_buffer.records = NULL;
+	
+	printf("[trace] %llu instructions recorded, producer stalled %llu times\n",
+		records_written, trace_buffer.stalls);
+}
+
+/**
+	Slow path for trace_next(), the ring is full as far as
+	the producer knows
+*/
+void trace_wait() {
+	unsigned long head;
+	unsigned long long start;
+	char stalled;
+	
+	head = atomic_load_explicit(&trace_buffer.head, memory_order_relaxed);
+	start = timeline_enabled ? timeline_now() : 0;
+	stalled = 0;
+	for(;;) {
+		trace_buffer.limit = atomic_load_explicit(&trace_buffer.tail, memory_order_acquire)
+			+ TRACE_BUFFER_SIZE;
+		if(head != trace_buffer.limit)
+			break;
+		
+		// Never drop records, wait for the writer instead
+		trace_buffer.stalls++;
+		stalled = 1;
+		SDL_Delay(1);
+	}
+	
+	if(timeline_enabled && stalled)
+		timeline_span("trace buffer full", "stall", start, timeline_now(), TIMELINE_EMULATOR);
+}
+
+/**
+Static Functions
+*/
+static int trace_writer(void * arg) {
+	unsigned long head, tail, count;
+	unsigned long long start;
+	char stopping;
+	
+	tail = atomic_load_explicit(&trace_buffer.tail, memory_order_relaxed);
+	for(;;) {
+		stopping = atomic_load(&writer_stop);
+		head = atomic_load_explicit(&trace_buffer.head, memory_order_acquire);
+		
+		// Only write in large sequential blocks unless shutting down
+		if(head - tail < TRACE_WRITE_CHUNK && !stopping) {
+			SDL_Delay(1);
+			continue;
+		}
+		if(head == tail)
+			break;
+		
+		// Contiguous part up to the end of the ring
+		count = head - tail;
+		if(count > TRACE_WRITE_CHUNK)
+			count = TRACE_WRITE_CHUNK;
+		if((tail & (TRACE_BUFFER_SIZE - 1)) + count > TRACE_BUFFER_SIZE)
+			count = TRACE_BUFFER_SIZE - (tail & (TRACE_BUFFER_SIZE - 1));
+		
+		start = timeline_enabled ? timeline_now() : 0;
+		fwrite(&trace_buffer.records[tail & (TRACE_BUFFER_SIZE - 1)],
+			sizeof(struct trace_record), count, trace_fp);
+		if(timeline_enabled)
+			timeline_span("write", "trace", start, timeline_now(), TIMELINE_TRACE_WRITER);
+		
+		tail += count;
+		records_written += count;
+		atomic_store_explicit(&trace_buffer.tail, tail, memory_order_release);
+	}
+	
+	return 0;
+}
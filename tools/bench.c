@@ -0,0 +1,391 @@
+/**
+Headless throughput benchmark
+
+Runs each workload for a fixed number of emulated frames and prints
+the results as JSON on stdout. Every image in BENCH_ROMS_DIR (make
+roms) is a workload too, next to the built in ones. reference_ns is
+the speed of the host itself, see bench_reference().
+
+usage: bench [-frames n] [-workload name]... [-rom file.gb]...
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+
+#include "cpu.h"
+#include "memory.h"
+#include "lcd.h"
+#include "graphics.h"
+#include "interrupt.h"
+#include "rom.h"
+
+#define BENCH_FRAMES        600
+#define BENCH_MAX_WORKLOADS 64
+#define BENCH_CODE_ADDRESS  0x150
+#define BENCH_ROMS_DIR      "build/roms"
+
+#define BENCH_REFERENCE_STEPS   (1 << 22)
+#define BENCH_REFERENCE_REPEATS 3
+
+/**
+Synthetic instruction mixes, loaded at $0150 and looping forever
+Only opcodes the CPU implements are used
+*/
+static const unsigned char mix_alu[] = {
+	0x3E, 0x12,             // LD A, $12
+	0x06, 0x34,             // LD B, $34
+	0x0E, 0x56,             // LD C, $56
+	0x16, 0x78,             // LD D, $78
+	0x1E, 0x9A,             // LD E, $9A
+	0x80, 0x91, 0xA2, 0xB3, // ADD A, B / SUB C / AND D / OR E
+	0xA8, 0xB9, 0x3C, 0x05, // XOR B / CP C / INC A / DEC B
+	0x0C, 0x83, 0x92, 0xA9, // INC C / ADD A, E / SUB D / XOR C
+	0xC6, 0x11,             // ADD A, $11
+	0xD6, 0x05,             // SUB $05
+	0xE6, 0xF0,             // AND $F0
+	0xFE, 0x20,             // CP $20
+	0x09, 0x23, 0x2B,       // ADD HL, BC / INC HL / DEC HL
+	0xC3, 0x50, 0x01        // JP $0150
+};
+static const unsigned char mix_load[] = {
+	0x21, 0x00, 0xC0,       // LD HL, $C000
+	0x11, 0x00, 0xD0,       // LD DE, $D000
+	0x7E, 0x12, 0x46, 0x70, // LD A, (HL) / LD (DE), A / LD B, (HL) / LD (HL), B
+	0x4F, 0x78, 0x41, 0x48, // LD C, A / LD A, B / LD B, C / LD C, B
+	0x79, 0x1A, 0x77,       // LD A, C / LD A, (DE) / LD (HL), A
+	0xF0, 0x44,             // LDH A, (LY)
+	0xE0, 0x80,             // LDH ($80), A
+	0xF0, 0x80,             // LDH A, ($80)
+	0xFA, 0x00, 0xC0,       // LD A, ($C000)
+	0xEA, 0x01, 0xC0,       // LD ($C001), A
+	0xC5, 0xC1,             // PUSH BC / POP BC
+	0xC3, 0x50, 0x01        // JP $0150
+};
+static const unsigned char mix_branch[] = {
+	0x06, 0x00,             // $0150 LD B, 0
+	0x05,                   // $0152 DEC B
+	0xCD, 0x60, 0x01,       // $0153 CALL $0160
+	0x20, 0xFA,             // $0156 JR NZ, $0152
+	0xC3, 0x50, 0x01,       // $0158 JP $0150
+	0x00, 0x00, 0x00, 0x00, 0x00,
+	0xC5, 0xC1, 0xC9        // $0160 PUSH BC / POP BC / RET
+};
+static const unsigned char mix_cb[] = {
+	0x21, 0x00, 0xC0,       // LD HL, $C000
+	0xCB, 0x10, 0xCB, 0x11, // RL B / RL C
+	0xCB, 0x30, 0xCB, 0x37, // SWAP B / SWAP A
+	0xCB, 0x60, 0xCB, 0x7C, // BIT 4, B / BIT 7, H
+	0xCB, 0x66,             // BIT 4, (HL)
+	0xCB, 0xC7, 0xCB, 0xD1, // SET 0, A / SET 2, C
+	0xCB, 0xC6, 0xCB, 0xFF, // SET 0, (HL) / SET 7, A
+	0xC3, 0x50, 0x01        // JP $0150
+};
+static const unsigned char mix_memcpy[] = {
+	0x21, 0x00, 0xC0,       // $0150 LD HL, $C000
+	0x11, 0x00, 0xD0,       // $0153 LD DE, $D000
+	0x0E, 0x80,             // $0156 LD C, $80
+	0x2A, 0x12, 0x13,       // $0158 LD A, (HL+) / LD (DE), A / INC DE
+	0x0D,                   // $015B DEC C
+	0x20, 0xFA,             // $015C JR NZ, $0158
+	0xC3, 0x50, 0x01        // $015E JP $0150
+};
+
+struct bench_workload {
+	const char * name;
+	const unsigned char * code; // Synthetic mix, NULL for the others
+	unsigned int length;
+	char * rom;                 // ROM file, NULL for the others
+};
+
+struct bench_result {
+	unsigned long long frames;
+	unsigned long long instructions;
+	unsigned long long cycles;
+	double seconds;
+};
+
+/**
+Static Functions
+*/
+static int bench_addRoms(struct bench_workload * workloads, int number_workloads);
+static void bench_header();
+static void bench_reset(struct bench_workload * workload);
+static char bench_run(struct bench_workload * workload, unsigned long long frames, struct bench_result * result);
+static char bench_selected(const char * name, char ** names, int number_names);
+static double bench_reference();
+static double bench_now();
+static int compare_names(const void * a, const void * b);
+
+/**
+Static Variables
+*/
+// Keeps the reference loop from being optimized out
+static volatile unsigned int sink;
+
+static struct bench_workload builtin_workloads[] = {
+	{ "bootstrap",  NULL,       0,                  NULL },
+	{ "mix_alu",    mix_alu,    sizeof(mix_alu),    NULL },
+	{ "mix_load",   mix_load,   sizeof(mix_load),   NULL },
+	{ "mix_branch", mix_branch, sizeof(mix_branch), NULL },
+	{ "mix_cb",     mix_cb,     sizeof(mix_cb),     NULL },
+	{ "mix_memcpy", mix_memcpy, sizeof(mix_memcpy), NULL }
+};
+
+int main(int argc, char ** argv) {
+	struct bench_workload workloads[BENCH_MAX_WORKLOADS];
+	struct bench_result result;
+	unsigned long long frames;
+	char * names[BENCH_MAX_WORKLOADS];
+	int number_workloads, number_names, i, first;
+	
+	frames = BENCH_FRAMES;
+	number_names = 0;
+	number_workloads = 0;
+	for(i = 0; i < sizeof(builtin_workloads) / sizeof(struct bench_workload); i++)
+		workloads[number_workloads++] = builtin_workloads[i];
+	number_workloads = bench_addRoms(workloads, number_workloads);
+	
+	for(i = 1; i < argc; i++) {
+		if(!strcmp(argv[i], "-frames") && i+1 < argc) {
+			frames = strtoull(argv[++i], NULL, 10);
+		} else if(!strcmp(argv[i], "-workload") && i+1 < argc) {
+			if(number_names < BENCH_MAX_WORKLOADS)
+				names[number_names++] = argv[++i];
+		} else if(!strcmp(argv[i], "-rom") && i+1 < argc && number_workloads < BENCH_MAX_WORKLOADS) {
+			i++;
+			workloads[number_workloads].name = strrchr(argv[i], '/') ? strrchr(argv[i], '/') + 1 : argv[i];
+			workloads[number_workloads].code = NULL;
+			workloads[number_workloads].length = 0;
+			workloads[number_workloads].rom = argv[i];
+			number_workloads++;
+		} else {
+			fprintf(stderr, "usage: %s [-frames n] [-workload name]... [-rom file.gb]...\n", argv[0]);
+			fprintf(stderr, "workloads:");
+			for(i = 0; i < number_workloads; i++)
+				fprintf(stderr, " %s", workloads[i].name);
+			fprintf(stderr, "\n");
+			return 1;
+		}
+	}
+	
+	memory_init();
+	interrupt_init();
+	graphics_setHeadless(1);
+	graphics_init(NULL);
+	lcd_init();
+	cpu_init();
+	
+	printf("{\n\t\"frames\": %llu,\n\t\"reference_ns\": %.3f,\n\t\"workloads\": [", frames, bench_reference());
+	first = 1;
+	for(i = 0; i < number_workloads; i++) {
+		if(!bench_selected(workloads[i].name, names, number_names))
+			continue;
+		
+		fprintf(stderr, "[bench] %s\n", workloads[i].name);
+		if(!bench_run(&workloads[i], frames, &result)) {
+			fprintf(stderr, "[bench] %s stopped at $%04x after %llu cycles\n",
+				workloads[i].name, cpu_state.registers.PC, result.cycles);
+			continue;
+		}
+		
+		printf("%s\n\t\t{\"name\": \"%s\", \"frames\": %llu, \"instructions\": %llu, \"cycles\": %llu, "
+			"\"seconds\": %.6f, \"mips\": %.3f, \"fps\": %.2f, \"ns_per_instruction\": %.3f}",
+			first ? "" : ",",
+			workloads[i].name,
+			result.frames,
+			result.instructions,
+			result.cycles,
+			result.seconds,
+			result.instructions / result.seconds / 1e6,
+			result.frames / result.seconds,
+			result.seconds * 1e9 / result.instructions
+		);
+		first = 0;
+	}
+	printf("\n\t]\n}\n");
+	
+	return 0;
+}
+
+/**
+Static Functions
+*/
+/**
+	Adds every .gb image in BENCH_ROMS_DIR, by name,
+	returns the new number of workloads
+*/
+static int bench_addRoms(struct bench_workload * workloads, int number_workloads) {
+	DIR * dir;
+	struct dirent * entry;
+	char * names[BENCH_MAX_WORKLOADS];
+	int number_names, i;
+	size_t length;
+	
+	dir = opendir(BENCH_ROMS_DIR);
+	if(!dir) {
+		fprintf(stderr, "[bench] No %s, make roms adds its workloads\n", BENCH_ROMS_DIR);
+		return number_workloads;
+	}
+	
+	number_names = 0;
+	while((entry = readdir(dir)) && number_names < BENCH_MAX_WORKLOADS - number_workloads) {
+		length = strlen(entry->d_name);
+		if(length > 3 && !strcmp(entry->d_name + length - 3, ".gb"))
+			names[number_names++] = strdup(entry->d_name);
+	}
+	closedir(dir);
+	qsort(names, number_names, sizeof(char *), compare_names);
+	
+	for(i = 0; i < number_names; i++) {
+		workloads[number_workloads].name = names[i];
+		workloads[number_workloads].code = NULL;
+		workloads[number_workloads].length = 0;
+		workloads[number_workloads].rom = malloc(sizeof(BENCH_ROMS_DIR) + strlen(names[i]) + 1);
+		sprintf(workloads[number_workloads].rom, "%s/%s", BENCH_ROMS_DIR, names[i]);
+		number_workloads++;
+	}
+	return number_workloads;
+}
+
+/**
+	Cartridge header the bootstrap ROM accepts: the logo it compares
+	against (its own copy at $00A8) and the header checksum. The entry
+	point parks the CPU on JR $0100 once it hands over, see bench_run.
+*/
+static void bench_header() {
+	unsigned char * mem, checksum;
+	int address;
+	
+	mem = memory_dump();
+	mem[0x100] = 0x18;
+	mem[0x101] = 0xFE;
+	memcpy(mem + 0x104, mem + 0xA8, 48);
+	memcpy(mem + 0x134, "BENCH BOOT", 10);
+	
+	checksum = 0;
+	for(address = 0x134; address < 0x14D; address++)
+		checksum = checksum - mem[address] - 1;
+	mem[0x14D] = checksum;
+}
+
+/**
+	Power on state for the workload
+*/
+static void bench_reset(struct bench_workload * workload) {
+	memory_reset();
+	cpu_reset();
+	lcd_reset();
+	
+	// Bootstrap starts at $0000 with the display off
+	if(!workload->code && !workload->rom) {
+		bench_header();
+		return;
+	}
+	
+	if(workload->rom)
+		rom_load(workload->rom);
+	cpu_rom_reset();
+	
+	if(workload->code) {
+		memcpy((char *)memory_dump() + BENCH_CODE_ADDRESS, workload->code, workload->length);
+		cpu_state.registers.PC = BENCH_CODE_ADDRESS;
+	}
+}
+
+/**
+	Returns 0 if the CPU stopped (unimplemented opcode) before the end
+	Bootstrap ends early, in the frame it hands over to the cartridge
+*/
+static char bench_run(struct bench_workload * workload, unsigned long long frames, struct bench_result * result) {
+	unsigned long long cycles;
+	double start;
+	
+	bench_reset(workload);
+	
+	cycles = frames * CPU_CYCLES_PER_FRAME;
+	start = bench_now();
+	while(cpu_state.running && cpu_state.total_cycles < cycles) {
+		cpu_run(CPU_CYCLES_PER_FRAME);
+		if(!workload->code && !workload->rom && cpu_state.registers.PC >= 0x100)
+			break;
+	}
+	result->seconds = bench_now() - start;
+	
+	result->cycles = cpu_state.total_cycles;
+	result->instructions = cpu_state.total_instructions;
+	result->frames = cpu_state.total_cycles / CPU_CYCLES_PER_FRAME;
+	
+	return cpu_state.running && result->instructions && result->seconds > 0;
+}
+
+static char bench_selected(const char * name, char ** names, int number_names) {
+	int i;
+	
+	if(!number_names)
+		return 1;
+	for(i = 0; i < number_names; i++) {
+		if(!strcmp(name, names[i]))
+			return 1;
+	}
+	return 0;
+}
+
+/**
+	Host speed in ns per step of a small interpreter loop that uses
+	no emulator code: dispatch on a byte, registers and a 256 byte
+	memory. Dividing a workload by it cancels out the host, so a
+	baseline recorded on one host holds on another.
+	Best of BENCH_REFERENCE_REPEATS.
+*/
+static double bench_reference() {
+	unsigned char program[256], memory[256];
+	unsigned int a, b, pc, seed;
+	unsigned long step;
+	double start, seconds, best;
+	int i;
+	
+	// Filled at run time so the compiler cannot fold the dispatch
+	seed = 1;
+	for(i = 0; i < 256; i++) {
+		seed = seed * 1103515245 + 12345;
+		program[i] = seed >> 16;
+		memory[i] = seed >> 24;
+	}
+	
+	best = 0;
+	for(i = 0; i < BENCH_REFERENCE_REPEATS; i++) {
+		a = b = pc = 0;
+		start = bench_now();
+		for(step = 0; step < BENCH_REFERENCE_STEPS; step++) {
+			switch(program[pc++ & 0xFF] & 0x7)
+			{
+				case 0: a += b; break;
+				case 1: b ^= a << 1; break;
+				case 2: a = memory[b & 0xFF]; break;
+				case 3: memory[a & 0xFF] = b; break;
+				case 4: b = (b >> 1) | (a << 7); break;
+				case 5: if(a & 1) pc += 3; break;
+				case 6: a -= memory[(a + b) & 0xFF]; break;
+				case 7: pc = (pc & ~0xF) | (b & 0xF); break;
+			}
+		}
+		seconds = bench_now() - start;
+		sink = a ^ b;
+		if(!i || seconds < best)
+			best = seconds;
+	}
+	return best * 1e9 / BENCH_REFERENCE_STEPS;
+}
+
+static double bench_now() {
+	struct timespec now;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static int compare_names(const void * a, const void * b) {
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
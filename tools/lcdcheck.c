@@ -0,0 +1,142 @@
+/**
+Checks that the LCD redraws every line that changed
+
+Each case draws a line, changes one thing it is drawn from and draws
+it again. The pixels have to match the line drawn from scratch, with
+lcd_setSkipUnchanged() off. Fails when a change left a stale line.
+
+usage: lcdcheck
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "memory.h"
+#include "lcd.h"
+#include "graphics.h"
+#include "interrupt.h"
+#include "ioports.h"
+
+#define CHECK_LINE   0
+#define CHECK_SPRITE 0xFE00
+#define CHECK_TILE   0x8010 // Tile 1, used by the sprite
+
+/**
+Static Functions
+*/
+static void setup(unsigned char bgp, unsigned char flags);
+static void drawLine(char skip_unchanged, unsigned int * pixels);
+static int check(const char * name, void (*change)());
+
+static void changeOBP0();
+static void changeOBP1();
+static void changeSpriteRow();
+
+/**
+Static Variables
+*/
+static struct lcd_registers * lcd_registers;
+static unsigned char * mem;
+
+int main(int argc, char ** argv) {
+	int failures;
+	
+	if(argc > 1) {
+		printf("usage: %s\n", argv[0]);
+		return 1;
+	}
+	
+	memory_init();
+	interrupt_init();
+	graphics_setHeadless(1);
+	graphics_init(NULL);
+	lcd_init();
+	cpu_init();
+	mem = memory_dump();
+	lcd_registers = (struct lcd_registers *)(mem + 0xFF40);
+	
+	failures = 0;
+	setup(0xFC, 0x00);
+	failures += check("obp0/bgp_fc", changeOBP0);
+	setup(0xFC, 0x10);
+	failures += check("obp1/bgp_fc", changeOBP1);
+	setup(0xFC, 0x80);
+	failures += check("sprite_row/behind_bg/bgp_fc", changeSpriteRow);
+	setup(0xE4, 0x00);
+	failures += check("sprite_row/bgp_e4", changeSpriteRow);
+	
+	if(failures) {
+		printf("%d checks left stale lines\n", failures);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+	BG of tile 0 everywhere, one sprite of tile 1 at the left of
+	CHECK_LINE with the given flags, the sprite row is color 1
+*/
+static void setup(unsigned char bgp, unsigned char flags) {
+	memset(mem + 0x8000, 0, 0x2000);
+	mem[CHECK_TILE + (CHECK_LINE % 8) * 2] = 0xFF;
+	mem[CHECK_TILE + (CHECK_LINE % 8) * 2 + 1] = 0x00;
+	lcd_vramChanged(0x8000, 0x2000);
+	
+	memset(mem + 0xFE00, 0, 0xA0);
+	mem[CHECK_SPRITE] = CHECK_LINE + 16;
+	mem[CHECK_SPRITE + 1] = 8;
+	mem[CHECK_SPRITE + 2] = 1;
+	mem[CHECK_SPRITE + 3] = flags;
+	lcd_oamChanged();
+	
+	lcd_registers->lcdc_control = 0x93;
+	lcd_registers->scroll_x = lcd_registers->scroll_y = 0;
+	lcd_registers->bgp = bgp;
+	lcd_registers->obp0 = 0xE4;
+	lcd_registers->obp1 = 0xE4;
+}
+
+/**
+	lcd_update() from the end of mode 3, which draws the line
+*/
+static void drawLine(char skip_unchanged, unsigned int * pixels) {
+	lcd_setSkipUnchanged(skip_unchanged);
+	lcd_registers->lcdc_status = (lcd_registers->lcdc_status & ~0x3) | 0x3;
+	lcd_registers->lcdc_y = CHECK_LINE;
+	cpu_state.lcd_wait_cycles = 0;
+	lcd_update(1);
+	memcpy(pixels, graphics_framebuffer + CHECK_LINE * LCD_SCREEN_WIDTH, LCD_SCREEN_WIDTH * sizeof(*pixels));
+}
+
+static int check(const char * name, void (*change)()) {
+	unsigned int before[LCD_SCREEN_WIDTH], after[LCD_SCREEN_WIDTH], expected[LCD_SCREEN_WIDTH];
+	
+	drawLine(1, before);
+	change();
+	drawLine(1, after);
+	drawLine(0, expected);
+	
+	if(!memcmp(before, expected, sizeof(expected))) {
+		printf("%-32s broken, the change does not show on the line\n", name);
+		return 1;
+	}
+	if(memcmp(after, expected, sizeof(expected))) {
+		printf("%-32s stale\n", name);
+		return 1;
+	}
+	printf("%-32s ok\n", name);
+	return 0;
+}
+
+static void changeOBP0() {
+	lcd_registers->obp0 = 0xEC;
+}
+
+static void changeOBP1() {
+	lcd_registers->obp1 = 0xEC;
+}
+
+static void changeSpriteRow() {
+	mem[CHECK_TILE + (CHECK_LINE % 8) * 2 + 1] = 0xFF;
+	lcd_vramChanged(CHECK_TILE + (CHECK_LINE % 8) * 2 + 1, 1);
+}
@@ -0,0 +1,410 @@
+/**
+Microbenchmarks for the core primitives
+
+Every benchmark is warmed up, then timed over several samples. The
+median is compared against a baseline (-baseline file) and the run
+fails when a primitive got slower than the threshold.
+
+usage: microbench [-filter text] [-baseline file] [-save file] [-threshold percent]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "cpu.h"
+#include "memory.h"
+#include "lcd.h"
+#include "graphics.h"
+#include "interrupt.h"
+#include "ioports.h"
+#include "disasm.h"
+
+#define MICRO_SAMPLES        11
+#define MICRO_SAMPLE_NS      1000000.0 // Each sample runs for about 1ms
+#define MICRO_WARMUP_NS      2000000.0
+#define MICRO_THRESHOLD      25.0      // Percent slower than the baseline
+#define MICRO_MIN_DELTA_NS   0.5       // Below this changes are noise
+#define MICRO_MAX_BENCHMARKS 1024
+
+#define MICRO_CODE_ADDRESS   0xC000
+
+struct micro_bench {
+	char name[48];
+	void (*run)(struct micro_bench * bench, unsigned long iterations);
+	unsigned short address;
+	unsigned char bytes[3];
+	unsigned char lcdc;
+	
+	double median, mean, stddev, min;
+	double baseline;
+};
+
+/**
+Static Functions
+*/
+static void run_read8(struct micro_bench * bench, unsigned long iterations);
+static void run_read16(struct micro_bench * bench, unsigned long iterations);
+static void run_write8(struct micro_bench * bench, unsigned long iterations);
+static void run_opcode(struct micro_bench * bench, unsigned long iterations);
+static void run_interrupt(struct micro_bench * bench, unsigned long iterations);
+static void run_scanline(struct micro_bench * bench, unsigned long iterations);
+
+static struct micro_bench * add_bench(const char * name, void (*run)(struct micro_bench *, unsigned long));
+static void add_benchmarks();
+static void measure(struct micro_bench * bench);
+static void load_baseline(char * filename);
+static void save_baseline(char * filename);
+static double now_ns();
+static int compare_doubles(const void * a, const void * b);
+
+/**
+Static Variables
+*/
+static struct micro_bench benchmarks[MICRO_MAX_BENCHMARKS];
+static int number_benchmarks;
+
+static struct lcd_registers * lcd_registers;
+static struct registers opcode_registers;
+
+// Keeps reads from being optimized out
+static volatile unsigned int sink;
+
+static const struct {
+	const char * name;
+	unsigned short address;
+} regions[] = {
+	{ "rom0", 0x0200 },
+	{ "romx", 0x4200 },
+	{ "vram", 0x8200 },
+	{ "xram", 0xA200 },
+	{ "wram", 0xC200 },
+	{ "echo", 0xE200 },
+	{ "oam",  0xFE10 },
+	{ "io",   0xFF42 },
+	{ "hram", 0xFF90 },
+	{ "ie",   0xFFFF }
+};
+
+int main(int argc, char ** argv) {
+	char * filter, * baseline, * save;
+	double threshold, delta;
+	int i, regressions;
+	
+	filter = baseline = save = NULL;
+	threshold = MICRO_THRESHOLD;
+	for(i = 1; i < argc; i++) {
+		if(!strcmp(argv[i], "-filter") && i+1 < argc) {
+			filter = argv[++i];
+		} else if(!strcmp(argv[i], "-baseline") && i+1 < argc) {
+			baseline = argv[++i];
+		} else if(!strcmp(argv[i], "-save") && i+1 < argc) {
+			save = argv[++i];
+		} else if(!strcmp(argv[i], "-threshold") && i+1 < argc) {
+			threshold = atof(argv[++i]);
+		} else {
+			printf("usage: %s [-filter text] [-baseline file] [-save file] [-threshold percent]\n", argv[0]);
+			return 1;
+		}
+	}
+	
+	memory_init();
+	interrupt_init();
+	graphics_setHeadless(1);
+	graphics_init(NULL);
+	lcd_init();
+	cpu_init();
+	lcd_registers = (struct lcd_registers *)((char *)memory_dump() + 0xFF40);
+	
+	add_benchmarks();
+	if(baseline)
+		load_baseline(baseline);
+	
+	printf("%-32s %10s %10s %8s %10s %8s\n", "Benchmark", "Median ns", "Min ns", "Stddev", "Baseline", "Delta");
+	regressions = 0;
+	for(i = 0; i < number_benchmarks; i++) {
+		if(filter && !strstr(benchmarks[i].name, filter)) {
+			benchmarks[i].median = -1;
+			continue;
+		}
+		
+		measure(&benchmarks[i]);
+		if(benchmarks[i].median < 0) {
+			printf("%-32s %10s\n", benchmarks[i].name, "stopped");
+			continue;
+		}
+		
+		printf("%-32s %10.2f %10.2f %7.1f%%",
+			benchmarks[i].name,
+			benchmarks[i].median,
+			benchmarks[i].min,
+			100.0 * benchmarks[i].stddev / benchmarks[i].mean
+		);
+		if(benchmarks[i].baseline > 0) {
+			delta = benchmarks[i].median - benchmarks[i].baseline;
+			printf(" %10.2f %+7.1f%%", benchmarks[i].baseline, 100.0 * delta / benchmarks[i].baseline);
+			if(delta > MICRO_MIN_DELTA_NS && 100.0 * delta / benchmarks[i].baseline > threshold) {
+				printf("  REGRESSION");
+				regressions++;
+			}
+		}
+		printf("\n");
+	}
+	
+	if(save)
+		save_baseline(save);
+	
+	if(regressions) {
+		printf("%d benchmarks regressed by more than %.0f%%\n", regressions, threshold);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+Static Functions
+*/
+static void run_read8(struct micro_bench * bench, unsigned long iterations) {
+	unsigned int total;
+	
+	total = 0;
+	while(iterations--)
+		total += memory_read8(bench->address);
+	sink = total;
+}
+
+static void run_read16(struct micro_bench * bench, unsigned long iterations) {
+	unsigned int total;
+	
+	total = 0;
+	while(iterations--)
+		total += memory_read16(bench->address);
+	sink = total;
+}
+
+static void run_write8(struct micro_bench * bench, unsigned long iterations) {
+	while(iterations--)
+		memory_write8(bench->address, iterations);
+}
+
+/**
+	One instruction through cpu_step() with the display off, registers
+	and code are restored every time so jumps and stores stay in WRAM
+*/
+static void run_opcode(struct micro_bench * bench, unsigned long iterations) {
+	unsigned char * mem;
+	
+	mem = memory_dump();
+	lcd_registers->lcdc_control = 0;
+	cpu_state.ime = 0;
+	while(iterations--) {
+		mem[MICRO_CODE_ADDRESS] = bench->bytes[0];
+		mem[MICRO_CODE_ADDRESS + 1] = bench->bytes[1];
+		mem[MICRO_CODE_ADDRESS + 2] = bench->bytes[2];
+		cpu_state.registers = opcode_registers;
+		cpu_state.halt = 0;
+		cpu_step();
+	}
+}
+
+static void run_interrupt(struct micro_bench * bench, unsigned long iterations) {
+	unsigned char * mem;
+	
+	mem = memory_dump();
+	while(iterations--) {
+		mem[0xFFFF] = bench->bytes[0];
+		mem[0xFF0F] = bench->bytes[0];
+		cpu_state.ime = 1;
+		cpu_state.registers.SP = 0xDFF0;
+		cpu_state.registers.PC = 0x0200;
+		interrupt_handle();
+	}
+}
+
+/**
+	lcd_update() from the end of mode 3, which draws the line
+	bytes[0] lets the LCD skip lines that are already in the framebuffer
+*/
+static void run_scanline(struct micro_bench * bench, unsigned long iterations) {
+	lcd_setSkipUnchanged(bench->bytes[0]);
+	lcd_registers->lcdc_control = bench->lcdc;
+	while(iterations--) {
+		lcd_registers->lcdc_status = (lcd_registers->lcdc_status & ~0x3) | 0x3;
+		lcd_registers->lcdc_y = iterations % 144;
+		cpu_state.lcd_wait_cycles = 0;
+		lcd_update(1);
+	}
+}
+
+static struct micro_bench * add_bench(const char * name, void (*run)(struct micro_bench *, unsigned long)) {
+	struct micro_bench * bench;
+	
+	bench = &benchmarks[number_benchmarks++];
+	memset(bench, 0, sizeof(struct micro_bench));
+	snprintf(bench->name, sizeof(bench->name), "%s", name);
+	bench->run = run;
+	return bench;
+}
+
+static void add_benchmarks() {
+	struct micro_bench * bench;
+	char name[48], text[DISASM_MAX_LENGTH];
+	int i;
+	
+	for(i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+		sprintf(name, "read8/%s", regions[i].name);
+		add_bench(name, run_read8)->address = regions[i].address;
+		
+		sprintf(name, "write8/%s", regions[i].name);
+		add_bench(name, run_write8)->address = regions[i].address;
+		
+		// read16 at $FFFF would run off the end
+		if(regions[i].address != 0xFFFF) {
+			sprintf(name, "read16/%s", regions[i].name);
+			add_bench(name, run_read16)->address = regions[i].address;
+		}
+	}
+	
+	// Operands point into WRAM: n = $10, nn = $C110
+	opcode_registers.AF = 0x1200;
+	opcode_registers.BC = 0xC400;
+	opcode_registers.DE = 0xC300;
+	opcode_registers.HL = 0xC200;
+	opcode_registers.SP = 0xDFF0;
+	opcode_registers.PC = MICRO_CODE_ADDRESS;
+	for(i = 0; i < 0x200; i++) {
+		bench = add_bench("", run_opcode);
+		if(i < 0x100) {
+			bench->bytes[0] = i;
+			bench->bytes[1] = 0x10;
+		} else {
+			bench->bytes[0] = 0xCB;
+			bench->bytes[1] = i & 0xFF;
+		}
+		bench->bytes[2] = 0xC1;
+		if(i == 0xCB)
+			bench->bytes[1] = 0x37; // SWAP A
+		
+		disasm_mnemonic(bench->bytes, text);
+		snprintf(bench->name, sizeof(bench->name), "opcode/%s%02X %s",
+			i > 0xFF ? "CB" : "", i & 0xFF, text);
+	}
+	
+	add_bench("interrupt_handle/vblank", run_interrupt)->bytes[0] = V_BLANK_INTERRUPT;
+	add_bench("interrupt_handle/joypad", run_interrupt)->bytes[0] = JOYPAD_INTERRUPT;
+	
+	// Display on, BG on, then tile data and map selection
+	add_bench("drawScanline/bg_off", run_scanline)->lcdc = 0x80;
+	add_bench("drawScanline/bg_8000_9800", run_scanline)->lcdc = 0x91;
+	add_bench("drawScanline/bg_8800_9800", run_scanline)->lcdc = 0x81;
+	add_bench("drawScanline/bg_8000_9c00", run_scanline)->lcdc = 0x99;
+	add_bench("drawScanline/bg_obj_8000_9800", run_scanline)->lcdc = 0x93;
+	
+	bench = add_bench("drawScanline/unchanged_8000_9800", run_scanline);
+	bench->lcdc = 0x93;
+	bench->bytes[0] = 1;
+}
+
+/**
+	Warm up, pick an iteration count that fills a sample, then take
+	MICRO_SAMPLES samples. median is -1 if the CPU stopped.
+*/
+static void measure(struct micro_bench * bench) {
+	double samples[MICRO_SAMPLES], start, elapsed, total;
+	unsigned long iterations;
+	int i;
+	
+	memory_reset();
+	cpu_reset();
+	
+	iterations = 1;
+	start = now_ns();
+	do {
+		bench->run(bench, iterations);
+		if(!cpu_state.running) {
+			bench->median = -1;
+			return;
+		}
+		iterations *= 2;
+	} while(now_ns() - start < MICRO_WARMUP_NS);
+	
+	elapsed = now_ns();
+	bench->run(bench, iterations);
+	elapsed = now_ns() - elapsed;
+	iterations = iterations * MICRO_SAMPLE_NS / (elapsed > 1 ? elapsed : 1);
+	if(!iterations) iterations = 1;
+	
+	total = 0;
+	for(i = 0; i < MICRO_SAMPLES; i++) {
+		start = now_ns();
+		bench->run(bench, iterations);
+		samples[i] = (now_ns() - start) / iterations;
+		total += samples[i];
+	}
+	qsort(samples, MICRO_SAMPLES, sizeof(double), compare_doubles);
+	
+	bench->median = samples[MICRO_SAMPLES / 2];
+	bench->min = samples[0];
+	bench->mean = total / MICRO_SAMPLES;
+	bench->stddev = 0;
+	for(i = 0; i < MICRO_SAMPLES; i++)
+		bench->stddev += (samples[i] - bench->mean) * (samples[i] - bench->mean);
+	bench->stddev = sqrt(bench->stddev / MICRO_SAMPLES);
+}
+
+/**
+	One "name<TAB>median ns" line per benchmark
+*/
+static void load_baseline(char * filename) {
+	char line[128], * tab;
+	FILE * fp;
+	int i;
+	
+	fp = fopen(filename, "r");
+	if(!fp) {
+		printf("[microbench] No baseline at %s\n", filename);
+		return;
+	}
+	while(fgets(line, sizeof(line), fp)) {
+		tab = strchr(line, '\t');
+		if(!tab || line[0] == '#')
+			continue;
+		*tab = 0;
+		for(i = 0; i < number_benchmarks; i++) {
+			if(!strcmp(benchmarks[i].name, line))
+				benchmarks[i].baseline = atof(tab + 1);
+		}
+	}
+	fclose(fp);
+}
+
+static void save_baseline(char * filename) {
+	FILE * fp;
+	int i;
+	
+	fp = fopen(filename, "w");
+	if(!fp) {
+		printf("[microbench] Cannot write %s\n", filename);
+		return;
+	}
+	fprintf(fp, "# microbench medians in ns, regenerate with ./microbench -save <file>\n");
+	for(i = 0; i < number_benchmarks; i++) {
+		if(benchmarks[i].median > 0)
+			fprintf(fp, "%s\t%.3f\n", benchmarks[i].name, benchmarks[i].median);
+	}
+	fclose(fp);
+}
+
+static double now_ns() {
+	struct timespec now;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+static int compare_doubles(const void * a, const void * b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	
+	return (x > y) - (x < y);
+}
@@ -0,0 +1,197 @@
+'''
+Compares the benchmark workloads against a stored baseline
+Runs ./bench several times, takes the median ns per instruction of
+every workload and fails if one got significantly slower
+
+Workloads are compared relative to the host reference bench measures
+in the same run (reference_ns), so a baseline recorded on one host
+holds on another. -absolute compares ns per instruction instead, for
+two builds measured on the same host. Baselines recorded with another
+number of frames are rejected.
+
+A slowdown is significant when it is above the threshold and above
+the noise, three times the combined relative spread (scaled median
+absolute deviation) of the baseline and the current runs. The noise
+can raise the limit to at most NOISE_CAP times the threshold, so a
+noisy baseline cannot hide large slowdowns.
+
+Runs are pinned to one CPU (-cpu) where the OS supports it
+
+usage: perfcheck.py [-bench ./bench] [-baseline file] [-runs n] [-frames n] [-threshold percent] [-cpu n] [-absolute] [-update]
+'''
+
+import json
+import os
+import subprocess
+import sys
+
+RUNS      = 5
+FRAMES    = 300
+THRESHOLD = 5.0  # Percent
+NOISE     = 3.0  # Spreads a slowdown has to exceed
+NOISE_CAP = 2.0  # Thresholds the noise may raise the limit to
+MAD_SCALE = 1.4826
+
+def median(values):
+	values = sorted(values)
+	middle = len(values) // 2
+	if len(values) % 2:
+		return values[middle]
+	return (values[middle - 1] + values[middle]) / 2
+
+def spread(values):
+	'''
+	Relative spread, the median absolute deviation scaled to be
+	comparable to a standard deviation, divided by the median
+	'''
+	center = median(values)
+	if center <= 0:
+		return 0.0
+	return MAD_SCALE * median([abs(value - center) for value in values]) / center
+
+def pin(cpu):
+	'''
+	Keeps this process and the benchmarks it starts on one CPU
+	'''
+	if cpu is None:
+		return
+	if not hasattr(os, 'sched_setaffinity'):
+		sys.stderr.write('[perfcheck] Cannot pin to a CPU on this OS\n')
+		return
+	os.sched_setaffinity(0, {cpu})
+
+def run_bench(bench, frames, runs):
+	'''
+	Returns ([reference ns of every run],
+	{workload: [(ns per instruction, relative to the reference) of every run]})
+	'''
+	references = []
+	results = {}
+	for run in range(runs):
+		sys.stderr.write('[perfcheck] run %d/%d\n' % (run + 1, runs))
+		output = json.loads(subprocess.run([bench, '-frames', str(frames)],
+			stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, check=True).stdout)
+		references.append(output['reference_ns'])
+		for workload in output['workloads']:
+			results.setdefault(workload['name'], []).append(
+				(workload['ns_per_instruction'], workload['ns_per_instruction'] / output['reference_ns']))
+	return references, results
+
+def summarize(references, results, frames, runs):
+	workloads = {}
+	for name, values in sorted(results.items()):
+		ns = [value[0] for value in values]
+		relative = [value[1] for value in values]
+		workloads[name] = {
+			'ns_per_instruction': round(median(ns), 4),
+			'ns_spread': round(spread(ns), 4),
+			'relative': round(median(relative), 4),
+			'spread': round(spread(relative), 4)
+		}
+	return {'frames': frames, 'runs': runs, 'reference_ns': round(median(references), 4), 'workloads': workloads}
+
+def compare(baseline, current, threshold, absolute):
+	'''
+	Prints the delta table, returns the number of slowdowns
+	'''
+	if absolute:
+		value, spread_key = 'ns_per_instruction', 'ns_spread'
+		print('ns per instruction')
+	else:
+		value, spread_key = 'relative', 'spread'
+		print('ns per instruction / ns per step of the host reference (%.3f ns, %.3f ns in the baseline)' % (
+			current['reference_ns'], baseline['reference_ns']))
+	slowdowns = 0
+	print('%-16s %12s %12s %9s %8s  %s' % ('Workload', 'Baseline', 'Current', 'Delta', 'Noise', 'Status'))
+	for name, result in sorted(current['workloads'].items()):
+		base = baseline['workloads'].get(name)
+		if not base:
+			print('%-16s %12s %12.3f %9s %8s  %s' % (name, '-', result[value], '-', '-', 'new'))
+			continue
+
+		delta = 100.0 * (result[value] - base[value]) / base[value]
+		noise = 100.0 * NOISE * (base[spread_key] ** 2 + result[spread_key] ** 2) ** 0.5
+		noise = min(noise, NOISE_CAP * threshold)
+		limit = max(threshold, noise)
+		if delta > limit:
+			status = 'SLOWER'
+			slowdowns += 1
+		elif delta < -limit:
+			status = 'faster'
+		else:
+			status = 'ok'
+		print('%-16s %12.3f %12.3f %+8.1f%% %7.1f%%  %s' % (
+			name, base[value], result[value], delta, noise, status))
+
+	for name in sorted(baseline['workloads']):
+		if name not in current['workloads']:
+			print('%-16s %12.3f %12s %9s %8s  %s' % (name, baseline['workloads'][name][value], '-', '-', '-', 'missing'))
+	return slowdowns
+
+def main(argv):
+	bench = './bench'
+	baseline_file = os.path.join(os.path.dirname(argv[0]), 'perf_baseline.json')
+	runs = RUNS
+	frames = FRAMES
+	threshold = THRESHOLD
+	cpu = None
+	absolute = False
+	update = False
+	i = 1
+	while i < len(argv):
+		if argv[i] == '-bench' and i + 1 < len(argv):
+			bench = argv[i + 1]
+			i += 1
+		elif argv[i] == '-baseline' and i + 1 < len(argv):
+			baseline_file = argv[i + 1]
+			i += 1
+		elif argv[i] == '-runs' and i + 1 < len(argv):
+			runs = int(argv[i + 1])
+			i += 1
+		elif argv[i] == '-frames' and i + 1 < len(argv):
+			frames = int(argv[i + 1])
+			i += 1
+		elif argv[i] == '-threshold' and i + 1 < len(argv):
+			threshold = float(argv[i + 1])
+			i += 1
+		elif argv[i] == '-cpu' and i + 1 < len(argv):
+			cpu = int(argv[i + 1])
+			i += 1
+		elif argv[i] == '-absolute':
+			absolute = True
+		elif argv[i] == '-update':
+			update = True
+		else:
+			print('usage: %s [-bench ./bench] [-baseline file] [-runs n] [-frames n] [-threshold percent] [-cpu n] [-absolute] [-update]' % argv[0])
+			return 1
+		i += 1
+
+	if not update:
+		with open(baseline_file) as f:
+			baseline = json.load(f)
+		if baseline.get('frames') != frames:
+			print('[perfcheck] %s was recorded over %s frames, not %d, use -frames %s or -update' % (
+				baseline_file, baseline.get('frames'), frames, baseline.get('frames')))
+			return 1
+		if 'reference_ns' not in baseline:
+			print('[perfcheck] %s has no host reference, record it again with -update' % baseline_file)
+			return 1
+
+	pin(cpu)
+	references, results = run_bench(bench, frames, runs)
+	current = summarize(references, results, frames, runs)
+	if update:
+		with open(baseline_file, 'w') as f:
+			json.dump(current, f, indent='\t', sort_keys=True)
+			f.write('\n')
+		print('[perfcheck] Wrote %s' % baseline_file)
+		return 0
+
+	slowdowns = compare(baseline, current, threshold, absolute)
+	if slowdowns:
+		print('%d workloads are significantly slower than %s' % (slowdowns, baseline_file))
+		return 1
+	return 0
+
+if __name__ == '__main__':
+	sys.exit(main(sys.argv))
@@ -0,0 +1,291 @@
+'''
+Generates synthetic .gb images for benchmarking
+Every image has a valid header (logo and checksums) so it also
+passes the bootstrap ROM, and only uses opcodes the CPU implements
+
+usage: romgen.py [-o directory] [target ...]
+'''
+
+import os
+import sys
+
+NINTENDO_LOGO = bytes([
+	0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B, 0x03, 0x73, 0x00, 0x83,
+	0x00, 0x0C, 0x00, 0x0D, 0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E,
+	0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99, 0xBB, 0xBB, 0x67, 0x63,
+	0x6E, 0x0E, 0xEC, 0xCC, 0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E
+])
+
+BANK_SIZE    = 0x4000
+CODE_ADDRESS = 0x150
+
+# Cartridge types ($0147)
+ROM_ONLY = 0x00
+MBC1     = 0x01
+
+class Code:
+	'''
+	Bytes placed at an address, with labels for jumps
+	Relative and absolute references are resolved by link()
+	'''
+	def __init__(self, address):
+		self.address = address
+		self.data = bytearray()
+		self.labels = {}
+		self.fixups = []
+
+	def here(self):
+		return self.address + len(self.data)
+
+	def label(self, name):
+		self.labels[name] = self.here()
+
+	def emit(self, *values):
+		self.data += bytes(values)
+
+	def jr(self, opcode, name):
+		'''JR / JR cc to a label'''
+		self.emit(opcode, 0)
+		self.fixups.append(('rel', len(self.data) - 1, name))
+
+	def jp(self, opcode, name):
+		'''JP / CALL (opcode) to a label'''
+		self.emit(opcode, 0, 0)
+		self.fixups.append(('abs', len(self.data) - 2, name))
+
+	def link(self):
+		for kind, offset, name in self.fixups:
+			target = self.labels[name]
+			if kind == 'rel':
+				delta = target - (self.address + offset + 1)
+				if delta < -128 or delta > 127:
+					raise ValueError('JR to %s out of range' % name)
+				self.data[offset] = delta & 0xFF
+			else:
+				self.data[offset] = target & 0xFF
+				self.data[offset + 1] = target >> 8
+		return bytes(self.data)
+
+'''
+Targets
+Each returns (cartridge type, banks, {address: bytes})
+'''
+def alu():
+	c = Code(CODE_ADDRESS)
+	c.emit(0x3E, 0x12, 0x06, 0x34, 0x0E, 0x56, 0x16, 0x78, 0x1E, 0x9A)
+	c.label('loop')
+	for _ in range(8):
+		c.emit(0x80, 0x91, 0xA2, 0xB3) # ADD A, B / SUB C / AND D / OR E
+		c.emit(0xA8, 0xB9, 0x3C, 0x0C) # XOR B / CP C / INC A / INC C
+		c.emit(0xC6, 0x11, 0xD6, 0x05) # ADD A, $11 / SUB $05
+		c.emit(0xE6, 0xF0, 0xFE, 0x20) # AND $F0 / CP $20
+		c.emit(0x09, 0x23, 0x1B, 0x3D) # ADD HL, BC / INC HL / DEC DE / DEC A
+	c.emit(0x05)                       # DEC B
+	c.jp(0xC2, 'loop')                 # JP NZ, too far for JR
+	c.jp(0xC3, 'loop')
+	return ROM_ONLY, 2, {CODE_ADDRESS: c.link()}
+
+def memcpy():
+	c = Code(CODE_ADDRESS)
+	c.label('start')
+	# Fill $C000-$CFFF
+	c.emit(0x21, 0x00, 0xC0)           # LD HL, $C000
+	c.emit(0x01, 0x00, 0x10)           # LD BC, $1000
+	c.label('fill')
+	c.emit(0x3E, 0x5A, 0x22)           # LD A, $5A / LD (HL+), A
+	c.emit(0x0B, 0x78, 0xB1)           # DEC BC / LD A, B / OR C
+	c.jr(0x20, 'fill')
+	# Copy it to $D000
+	c.emit(0x21, 0x00, 0xC0)           # LD HL, $C000
+	c.emit(0x11, 0x00, 0xD0)           # LD DE, $D000
+	c.emit(0x01, 0x00, 0x10)           # LD BC, $1000
+	c.label('copy')
+	c.emit(0x2A, 0x12, 0x13)           # LD A, (HL+) / LD (DE), A / INC DE
+	c.emit(0x0B, 0x78, 0xB1)           # DEC BC / LD A, B / OR C
+	c.jr(0x20, 'copy')
+	# Copy with an 8 bit counter, byte by byte through B
+	c.emit(0x21, 0x00, 0xD0)           # LD HL, $D000
+	c.emit(0x11, 0x00, 0xC8)           # LD DE, $C800
+	c.emit(0x0E, 0x00)                 # LD C, 0 (256 iterations)
+	c.label('slow')
+	c.emit(0x46, 0x23, 0x78, 0x12)     # LD B, (HL) / INC HL / LD A, B / LD (DE), A
+	c.emit(0x13, 0x0D)                 # INC DE / DEC C
+	c.jr(0x20, 'slow')
+	c.jp(0xC3, 'start')
+	return ROM_ONLY, 2, {CODE_ADDRESS: c.link()}
+
+def cb():
+	c = Code(CODE_ADDRESS)
+	c.emit(0x21, 0x00, 0xC0)           # LD HL, $C000
+	c.label('loop')
+	for _ in range(4):
+		c.emit(0xCB, 0x10, 0xCB, 0x11, 0xCB, 0x12, 0xCB, 0x13) # RL B, C, D, E
+		c.emit(0xCB, 0x30, 0xCB, 0x31, 0xCB, 0x37)             # SWAP B, C, A
+		c.emit(0xCB, 0x60, 0xCB, 0x6F, 0xCB, 0x7C, 0xCB, 0x66) # BIT 4, B / BIT 5, A / BIT 7, H / BIT 4, (HL)
+		c.emit(0xCB, 0xC7, 0xCB, 0xD1, 0xCB, 0xEA, 0xCB, 0xFB) # SET 0, A / SET 2, C / SET 5, D / SET 7, E
+		c.emit(0xCB, 0xC6, 0xCB, 0x36)                         # SET 0, (HL) / SWAP (HL)
+		c.emit(0x17)                                           # RLA
+	c.jp(0xC3, 'loop')
+	return ROM_ONLY, 2, {CODE_ADDRESS: c.link()}
+
+def vblank():
+	'''Main loop spins while a heavy V_BLANK handler does the work'''
+	# A is left alone by the main loop, POP AF is not usable yet
+	handler = Code(0x40)
+	handler.emit(0xC5, 0xD5, 0xE5)       # PUSH BC, DE, HL
+	handler.emit(0xF0, 0x80, 0x3C, 0xE0, 0x80) # LDH A, ($80) / INC A / LDH ($80), A
+	# Touch 64 bytes of WRAM
+	handler.emit(0x21, 0x00, 0xC0, 0x06, 0x40) # LD HL, $C000 / LD B, $40
+	handler.label('touch')
+	handler.emit(0x7E, 0x3C, 0x22, 0x05) # LD A, (HL) / INC A / LD (HL+), A / DEC B
+	handler.jr(0x20, 'touch')
+	handler.emit(0xE1, 0xD1, 0xC1)       # POP HL, DE, BC
+	handler.emit(0xD9)                   # RETI
+
+	c = Code(CODE_ADDRESS)
+	c.emit(0xAF, 0xE0, 0x80)             # XOR A / LDH ($80), A
+	c.emit(0x3E, 0x01, 0xE0, 0xFF)       # LD A, V_BLANK / LDH (IE), A
+	c.emit(0xFB)                         # EI
+	c.label('spin')
+	c.emit(0x04, 0x00)                   # INC B / NOP
+	c.jr(0x18, 'spin')
+	return ROM_ONLY, 2, {0x40: handler.link(), CODE_ADDRESS: c.link()}
+
+def banks():
+	'''Switch through the MBC1 banks and call into each one'''
+	c = Code(CODE_ADDRESS)
+	c.label('start')
+	c.emit(0x06, 0x01)                   # LD B, 1
+	c.label('next')
+	c.emit(0x78, 0xEA, 0x00, 0x20)       # LD A, B / LD ($2000), A
+	c.emit(0xCD, 0x00, 0x40)             # CALL $4000
+	c.emit(0x04, 0x78, 0xFE, 0x04)       # INC B / LD A, B / CP 4
+	c.jr(0x20, 'next')
+	c.jp(0xC3, 'start')
+
+	regions = {CODE_ADDRESS: c.link()}
+	for bank in range(1, 4):
+		# Each bank sums a table of its own
+		r = Code(0x4000)
+		r.emit(0xC5, 0x21, 0x00, 0x41, 0x0E, 0x40, 0xAF) # PUSH BC / LD HL, $4100 / LD C, $40 / XOR A
+		r.label('sum')
+		r.emit(0x86, 0x23, 0x0D)             # ADD A, (HL) / INC HL / DEC C
+		r.jr(0x20, 'sum')
+		r.emit(0xE0, 0x81, 0xC1, 0xC9)       # LDH ($81), A / POP BC / RET
+		regions[bank * BANK_SIZE] = r.link()
+		regions[bank * BANK_SIZE + 0x100] = bytes((bank * 7 + i) & 0xFF for i in range(0x40))
+	return MBC1, 4, regions
+
+def ppu():
+	'''Scroll every line, move every sprite every frame'''
+	c = Code(CODE_ADDRESS)
+	# Display off while setting up
+	c.emit(0xAF, 0xE0, 0x40)             # XOR A / LDH (LCDC), A
+	# Tiles $8000-$8FFF, alternating pattern
+	c.emit(0x21, 0x00, 0x80, 0x01, 0x00, 0x10) # LD HL, $8000 / LD BC, $1000
+	c.label('tiles')
+	c.emit(0x79, 0x22, 0x0B, 0x78, 0xB1) # LD A, C / LD (HL+), A / DEC BC / LD A, B / OR C
+	c.jr(0x20, 'tiles')
+	# Background map $9800-$9BFF
+	c.emit(0x21, 0x00, 0x98, 0x01, 0x00, 0x04) # LD HL, $9800 / LD BC, $0400
+	c.label('map')
+	c.emit(0x79, 0xE6, 0x3F, 0x22, 0x0B, 0x78, 0xB1) # LD A, C / AND $3F / LD (HL+), A / DEC BC / LD A, B / OR C
+	c.jr(0x20, 'map')
+	# 40 sprites
+	c.emit(0x21, 0x00, 0xFE, 0x06, 0x28) # LD HL, $FE00 / LD B, 40
+	c.label('oam')
+	c.emit(0x78, 0x87, 0x87, 0x22)       # LD A, B / ADD A, A / ADD A, A / LD (HL+), A   Y
+	c.emit(0x78, 0x87, 0x22)             # LD A, B / ADD A, A / LD (HL+), A           X
+	c.emit(0x78, 0x22, 0xAF, 0x22)       # LD A, B / LD (HL+), A / XOR A / LD (HL+), A   tile, flags
+	c.emit(0x05)                         # DEC B
+	c.jr(0x20, 'oam')
+	c.emit(0x3E, 0xE4, 0xE0, 0x47, 0xE0, 0x48) # LD A, $E4 / LDH (BGP), A / LDH (OBP0), A
+	c.emit(0x3E, 0x93, 0xE0, 0x40)       # LD A, $93 / LDH (LCDC), A   BG, OBJ, display on
+
+	c.label('line')
+	c.emit(0xF0, 0x44, 0x47)             # LDH A, (LY) / LD B, A
+	c.label('wait')
+	c.emit(0xF0, 0x44, 0xB8)             # LDH A, (LY) / CP B
+	c.jr(0x28, 'wait')                   # JR Z
+	c.emit(0xF0, 0x43, 0x3C, 0xE0, 0x43) # LDH A, (SCX) / INC A / LDH (SCX), A
+	c.emit(0xF0, 0x44, 0xFE, 0x90)       # LDH A, (LY) / CP 144
+	c.jr(0x20, 'line')
+	# V_BLANK, scroll down and move the sprites right
+	c.emit(0xF0, 0x42, 0x3C, 0xE0, 0x42) # LDH A, (SCY) / INC A / LDH (SCY), A
+	c.emit(0x21, 0x01, 0xFE, 0x06, 0x28) # LD HL, $FE01 / LD B, 40
+	c.label('move')
+	c.emit(0x34, 0x2C, 0x2C, 0x2C, 0x2C) # INC (HL) / INC L x4
+	c.emit(0x05)                         # DEC B
+	c.jr(0x20, 'move')
+	c.label('vblank')
+	c.emit(0xF0, 0x44, 0xFE, 0x90)       # LDH A, (LY) / CP 144
+	c.jr(0x28, 'vblank')
+	c.jr(0x18, 'line')
+	return ROM_ONLY, 2, {CODE_ADDRESS: c.link()}
+
+TARGETS = {
+	'alu': alu,
+	'memcpy': memcpy,
+	'cb': cb,
+	'vblank': vblank,
+	'banks': banks,
+	'ppu': ppu
+}
+
+def build(name, cartridge_type, banks, regions):
+	'''Complete image with header and checksums'''
+	rom = bytearray(banks * BANK_SIZE)
+	for address, data in regions.items():
+		if address < 0x150 and address + len(data) > 0x100:
+			raise ValueError('%s overlaps the header' % name)
+		rom[address:address + len(data)] = data
+
+	# Entry point: NOP / JP $0150
+	rom[0x100:0x104] = bytes([0x00, 0xC3, CODE_ADDRESS & 0xFF, CODE_ADDRESS >> 8])
+	rom[0x104:0x134] = NINTENDO_LOGO
+	title = ('BENCH ' + name.upper()).encode('ascii')[:15]
+	rom[0x134:0x134 + len(title)] = title
+	rom[0x147] = cartridge_type
+	rom[0x148] = {2: 0x00, 4: 0x01, 8: 0x02}[banks]
+	rom[0x149] = 0x00 # No RAM
+	rom[0x14A] = 0x01 # Non-Japanese
+	rom[0x14B] = 0x33 # Use the new licensee code
+
+	# Checked by the bootstrap ROM
+	checksum = 0
+	for i in range(0x134, 0x14D):
+		checksum = (checksum - rom[i] - 1) & 0xFF
+	rom[0x14D] = checksum
+
+	checksum = sum(rom) & 0xFFFF
+	rom[0x14E] = checksum >> 8
+	rom[0x14F] = checksum & 0xFF
+	return bytes(rom)
+
+def main(argv):
+	directory = '.'
+	names = []
+	i = 1
+	while i < len(argv):
+		if argv[i] == '-o' and i + 1 < len(argv):
+			directory = argv[i + 1]
+			i += 1
+		elif argv[i] in TARGETS:
+			names.append(argv[i])
+		else:
+			print('usage: %s [-o directory] [target ...]' % argv[0])
+			print('targets: ' + ' '.join(TARGETS))
+			return 1
+		i += 1
+
+	os.makedirs(directory, exist_ok=True)
+	for name in names or TARGETS:
+		cartridge_type, banks, regions = TARGETS[name]()
+		path = os.path.join(directory, name + '.gb')
+		with open(path, 'wb') as f:
+			f.write(build(name, cartridge_type, banks, regions))
+		print(path)
+	return 0
+
+if __name__ == '__main__':
+	sys.exit(main(sys.argv))
@@ -0,0 +1,75 @@
+/**
+Decodes trace files written by the emulator's -trace option
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+#include "disasm.h"
+
+#define DECODE_BATCH 4096
+
+int main(int argc, char ** argv) {
+	struct trace_file_header header;
+	struct trace_record * records;
+	unsigned long long skip, count, index;
+	char text[DISASM_MAX_LENGTH];
+	size_t n;
+	FILE * fp;
+	int i;
+	
+	if(argc < 2) {
+		printf("usage: %s <trace file> [-s skip] [-n count]\n", argv[0]);
+		return 1;
+	}
+	
+	skip = 0;
+	count = ~0ULL;
+	for(i = 2; i < argc; i++) {
+		if(!strcmp(argv[i], "-s") && i+1 < argc)
+			skip = strtoull(argv[++i], NULL, 0);
+		if(!strcmp(argv[i], "-n") && i+1 < argc)
+			count = strtoull(argv[++i], NULL, 0);
+	}
+	
+	fp = fopen(argv[1], "rb");
+	if(!fp) {
+		printf("Cannot open %s\n", argv[1]);
+		return 1;
+	}
+	
+	if(fread(&header, sizeof(header), 1, fp) != 1 ||
+		strcmp(header.magic, TRACE_MAGIC) ||
+		header.version != TRACE_VERSION ||
+		header.record_size != sizeof(struct trace_record)) {
+		printf("%s is not a version %d trace file\n", argv[1], TRACE_VERSION);
+		return 1;
+	}
+	
+	fseek(fp, skip * sizeof(struct trace_record), SEEK_CUR);
+	records = malloc(DECODE_BATCH * sizeof(struct trace_record));
+	
+	index = skip;
+	while(count && (n = fread(records, sizeof(struct trace_record), DECODE_BATCH, fp))) {
+		for(size_t r = 0; r < n && count; r++, count--, index++) {
+			disasm_bytes(records[r].pc, records[r].opcode, text);
+			printf("%10llu %12llu $%04x  %-24s AF=%04x BC=%04x DE=%04x HL=%04x SP=%04x FLAG=%02x\n",
+				index,
+				records[r].cycles,
+				records[r].pc,
+				text,
+				records[r].af,
+				records[r].bc,
+				records[r].de,
+				records[r].hl,
+				records[r].sp,
+				records[r].flag
+			);
+		}
+	}
+	
+	free(records);
+	fclose(fp);
+	return 0;
+}